@@ -9,7 +9,21 @@ layout(location = 1) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
+// built twice, see fbuild.bff:
+// frag.spv: samples the texture of set 0
+// frag_bindless.spv (TEXTURE_TABLE defined): samples the texture table of set 1 at the pushed index
+#ifdef TEXTURE_TABLE
+layout(set = 1, binding = 0) uniform sampler2D textureTable[64]; // TextureTableSize
+
+layout(push_constant) uniform DrawPushConstants
+{
+    layout(offset = 64) uint textureIndex;
+} draw;
+
+#define texSampler textureTable[draw.textureIndex]
+#else
 layout(set = 0, binding = 1) uniform sampler2D texSampler;
+#endif
 
 void main()
 {
@@ -1,5 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#ifdef INSTANCED
+#extension GL_ARB_shader_viewport_layer_array : enable
+#endif
 
 layout(set = 0, binding = 0) uniform UniformBufferObject
 {
@@ -8,21 +11,52 @@ layout(set = 0, binding = 0) uniform UniformBufferObject
     mat4 proj;
 } ubo;
 
+#ifdef PUSH_CONSTANTS
+layout(push_constant) uniform DrawPushConstants
+{
+    mat4 modelViewProj;
+} draw;
+#endif
+
 out gl_PerVertex
 {
     vec4 gl_Position;
 };
 
+// built six times, see fbuild.bff:
+// vert.spv: float positions, colors and texcoords (VERTEX_COLOR defined)
+// vert_packed.spv: 16-bit unorm positions (dequantized by ubo.model), half float texcoords, no colors
+// vert_instanced.spv, vert_packed_instanced.spv (INSTANCED defined): the transform, including any
+// dequantization, and the viewport come from per instance attributes instead of the ubo
+// vert_push.spv, vert_packed_push.spv (PUSH_CONSTANTS defined): the transform, including any
+// dequantization, is pushed per draw instead
 layout(location = 0) in vec3 inPosition;
+#ifdef VERTEX_COLOR
 layout(location = 1) in vec3 inColor;
+#endif
 layout(location = 2) in vec2 inTexCoord;
+#ifdef INSTANCED
+layout(location = 3) in mat4 inModelViewProj; // locations 3 - 6
+layout(location = 7) in uint inViewportIndex;
+#endif
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main()
 {
+#ifdef INSTANCED
+    gl_Position = inModelViewProj * vec4(inPosition, 1.0);
+    gl_ViewportIndex = int(inViewportIndex);
+#elif defined(PUSH_CONSTANTS)
+    gl_Position = draw.modelViewProj * vec4(inPosition, 1.0);
+#else
     gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+#endif
+#ifdef VERTEX_COLOR
     fragColor = inColor;
+#else
+    fragColor = vec3(1.0);
+#endif
     fragTexCoord = inTexCoord;
 }
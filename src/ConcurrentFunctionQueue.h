@@ -0,0 +1,199 @@
+#pragma once
+
+#include "InplaceFunction.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+// Bounded multi producer, multi consumer queue of functions (Vyukov style ring buffer).
+// Queue and Run* are lock free and never allocate after construction. Wait and WaitIdle only
+// touch the mutex when somebody is actually sleeping.
+template <size_t Capacity = 256, size_t FunctionSize = 56>
+class ConcurrentFunctionQueue
+{
+	static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+public:
+
+	using Function = InplaceFunction<FunctionSize>;
+
+	ConcurrentFunctionQueue()
+		: myCells(std::make_unique<Cell[]>(Capacity))
+	{
+		for (size_t cellIt = 0; cellIt < Capacity; cellIt++)
+			myCells[cellIt].sequence.store(cellIt, std::memory_order_relaxed);
+	}
+
+	// blocks (yielding) while the queue is full
+	template <typename Callable, typename... Args>
+	void Queue(Callable&& callable, Args&&... args)
+	{
+		Function function(
+			[callable = std::forward<Callable>(callable),
+			 args = std::make_tuple(std::forward<Args>(args)...)]() mutable
+		{
+			std::apply(callable, args);
+		});
+
+		myPendingCount.fetch_add(1, std::memory_order_relaxed);
+
+		while (!tryPush(function))
+			std::this_thread::yield();
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (myWaitingConsumerCount.load(std::memory_order_relaxed) > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(myMutex);
+			}
+			myWorkCondition.notify_one();
+		}
+	}
+
+	bool RunOne()
+	{
+		Function function;
+		if (!tryPop(function))
+			return false;
+
+		function();
+		function.reset();
+
+		if (myPendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (myWaitingIdleCount.load(std::memory_order_relaxed) > 0)
+			{
+				{
+					std::lock_guard<std::mutex> lock(myMutex);
+				}
+				myIdleCondition.notify_all();
+			}
+		}
+
+		return true;
+	}
+
+	void RunAll()
+	{
+		while (RunOne())
+		{ }
+	}
+
+	// consumer side: sleep until there is something to run
+	void Wait()
+	{
+		myWaitingConsumerCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		{
+			std::unique_lock<std::mutex> lock(myMutex);
+			myWorkCondition.wait(lock, [this] { return !empty(); });
+		}
+		myWaitingConsumerCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// producer side: sleep until everything queued so far has finished running
+	void WaitIdle()
+	{
+		myWaitingIdleCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		{
+			std::unique_lock<std::mutex> lock(myMutex);
+			myIdleCondition.wait(lock, [this] { return myPendingCount.load(std::memory_order_acquire) == 0; });
+		}
+		myWaitingIdleCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	bool empty() const
+	{
+		size_t pos = myDequeuePos.load(std::memory_order_acquire);
+		const Cell& cell = myCells[pos & (Capacity - 1)];
+		return static_cast<intptr_t>(cell.sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos + 1) < 0;
+	}
+
+private:
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		Function function;
+	};
+
+	bool tryPush(Function& function)
+	{
+		Cell* cell;
+		size_t pos = myEnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &myCells[pos & (Capacity - 1)];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (myEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false; // full
+			}
+			else
+			{
+				pos = myEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->function = std::move(function);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	bool tryPop(Function& outFunction)
+	{
+		Cell* cell;
+		size_t pos = myDequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &myCells[pos & (Capacity - 1)];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (myDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false; // empty
+			}
+			else
+			{
+				pos = myDequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		outFunction = std::move(cell->function);
+		cell->sequence.store(pos + Capacity, std::memory_order_release);
+
+		return true;
+	}
+
+	std::unique_ptr<Cell[]> myCells;
+
+	alignas(64) std::atomic<size_t> myEnqueuePos = 0;
+	alignas(64) std::atomic<size_t> myDequeuePos = 0;
+	alignas(64) std::atomic<uint32_t> myPendingCount = 0;
+
+	std::atomic<uint32_t> myWaitingConsumerCount = 0;
+	std::atomic<uint32_t> myWaitingIdleCount = 0;
+	std::mutex myMutex;
+	std::condition_variable myWorkCondition;
+	std::condition_variable myIdleCondition;
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "Hash.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Open addressing (linear probing) table from a 64-bit hash to a uint32_t index. The keys
+// themselves live with the caller, each slot only keeps 32 bits of the hash to skip most
+// key compares. Capacity is fixed at construction, so size it for the worst case up front.
+class HashIndexTable
+{
+public:
+
+	static constexpr uint32_t InvalidIndex = ~0u;
+
+	HashIndexTable(size_t maxCount)
+	{
+		size_t capacity = 16;
+		while (capacity < maxCount + maxCount / 2)
+			capacity <<= 1;
+
+		mySlots.resize(capacity, { 0, InvalidIndex });
+		myMask = capacity - 1;
+	}
+
+	// Returns the index of an equal key if there is one, otherwise stores index and returns it.
+	// equal(existingIndex) compares the key being looked up against the one stored at existingIndex.
+	template <typename Equal>
+	uint32_t findOrInsert(uint64_t hash, uint32_t index, Equal&& equal)
+	{
+		uint32_t tag = static_cast<uint32_t>(hash >> 32);
+
+		for (size_t slotIt = hash & myMask;; slotIt = (slotIt + 1) & myMask)
+		{
+			Slot& slot = mySlots[slotIt];
+
+			if (slot.index == InvalidIndex)
+			{
+				slot.tag = tag;
+				slot.index = index;
+				mySize++;
+				return index;
+			}
+
+			if (slot.tag == tag && equal(slot.index))
+				return slot.index;
+		}
+	}
+
+	inline size_t size() const { return mySize; }
+
+private:
+
+	struct Slot
+	{
+		uint32_t tag;
+		uint32_t index;
+	};
+
+	std::vector<Slot> mySlots;
+	size_t myMask = 0;
+	size_t mySize = 0;
+};
+
+// Collapses makeValue(0 .. count - 1) into its unique values, in order of first occurrence,
+// plus one index into them per input. Values compare bitwise. makeValue is called from several
+// threads and more than once per input, so it should be a cheap pure function.
+//
+// Inputs are hashed in chunks, scattered into shards on the top hash bits and each shard is
+// deduplicated in its own table. Output is identical to the single threaded path.
+template <typename T, typename MakeValue>
+void deduplicate(
+	uint32_t count,
+	MakeValue&& makeValue,
+	JobSystem& jobSystem,
+	std::vector<T>& outValues,
+	std::vector<uint32_t>& outIndices)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	constexpr uint32_t minChunkSize = 64 * 1024;
+
+	outValues.clear();
+	outIndices.resize(count);
+
+	uint32_t threadCount = jobSystem.getThreadCount() + 1; // the calling thread helps out
+	uint32_t chunkCount = std::min((count + minChunkSize - 1) / minChunkSize, threadCount * 4);
+
+	if (chunkCount <= 1 || threadCount == 1)
+	{
+		HashIndexTable table(count);
+		outValues.reserve(count / 4); // guesstimate
+
+		for (uint32_t valueIt = 0; valueIt < count; valueIt++)
+		{
+			T value = makeValue(valueIt);
+			uint32_t valueCount = static_cast<uint32_t>(outValues.size());
+			uint32_t index = table.findOrInsert(hashBytes(value), valueCount, [&outValues, &value](uint32_t existing)
+			{
+				return std::memcmp(&outValues[existing], &value, sizeof(T)) == 0;
+			});
+
+			if (index == valueCount)
+				outValues.push_back(value);
+
+			outIndices[valueIt] = index;
+		}
+
+		return;
+	}
+
+	uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	uint32_t shardBits = 0;
+	while ((1u << shardBits) < threadCount * 4)
+		shardBits++;
+	uint32_t shardCount = 1u << shardBits;
+
+	auto getShard = [shardBits](uint64_t hash) { return static_cast<uint32_t>(hash >> (64 - shardBits)); };
+	auto getChunkEnd = [count, chunkSize](uint32_t chunkIt) { return std::min(count, (chunkIt + 1) * chunkSize); };
+
+	std::vector<uint64_t> hashes(count);
+	std::vector<uint32_t> shardOffsets(chunkCount * shardCount); // [chunk][shard]
+
+	jobSystem.parallelFor(chunkCount, [&](uint32_t chunkIt)
+	{
+		uint32_t* chunkShardCounts = &shardOffsets[chunkIt * shardCount];
+
+		for (uint32_t valueIt = chunkIt * chunkSize; valueIt < getChunkEnd(chunkIt); valueIt++)
+		{
+			T value = makeValue(valueIt);
+			hashes[valueIt] = hashBytes(value);
+			chunkShardCounts[getShard(hashes[valueIt])]++;
+		}
+	});
+
+	// shard major, so every shard's inputs end up contiguous and in ascending order
+	std::vector<uint32_t> shardBegins(shardCount + 1);
+	uint32_t offset = 0;
+	for (uint32_t shardIt = 0; shardIt < shardCount; shardIt++)
+	{
+		shardBegins[shardIt] = offset;
+		for (uint32_t chunkIt = 0; chunkIt < chunkCount; chunkIt++)
+		{
+			uint32_t shardCountInChunk = shardOffsets[chunkIt * shardCount + shardIt];
+			shardOffsets[chunkIt * shardCount + shardIt] = offset;
+			offset += shardCountInChunk;
+		}
+	}
+	shardBegins[shardCount] = offset;
+
+	std::vector<uint32_t> shardInputs(count);
+
+	jobSystem.parallelFor(chunkCount, [&](uint32_t chunkIt)
+	{
+		uint32_t* chunkShardOffsets = &shardOffsets[chunkIt * shardCount];
+
+		for (uint32_t valueIt = chunkIt * chunkSize; valueIt < getChunkEnd(chunkIt); valueIt++)
+			shardInputs[chunkShardOffsets[getShard(hashes[valueIt])]++] = valueIt;
+	});
+
+	std::vector<uint32_t> firstOccurrences(count);
+
+	jobSystem.parallelFor(shardCount, [&](uint32_t shardIt)
+	{
+		HashIndexTable table(shardBegins[shardIt + 1] - shardBegins[shardIt]);
+
+		for (uint32_t inputIt = shardBegins[shardIt]; inputIt < shardBegins[shardIt + 1]; inputIt++)
+		{
+			uint32_t valueIt = shardInputs[inputIt];
+			T value = makeValue(valueIt);
+
+			firstOccurrences[valueIt] = table.findOrInsert(hashes[valueIt], valueIt, [&makeValue, &value](uint32_t existing)
+			{
+				T existingValue = makeValue(existing);
+				return std::memcmp(&existingValue, &value, sizeof(T)) == 0;
+			});
+		}
+	});
+
+	std::vector<uint32_t> uniqueOffsets(chunkCount + 1);
+
+	jobSystem.parallelFor(chunkCount, [&](uint32_t chunkIt)
+	{
+		uint32_t uniqueCount = 0;
+		for (uint32_t valueIt = chunkIt * chunkSize; valueIt < getChunkEnd(chunkIt); valueIt++)
+			uniqueCount += (firstOccurrences[valueIt] == valueIt);
+
+		uniqueOffsets[chunkIt + 1] = uniqueCount;
+	});
+
+	for (uint32_t chunkIt = 0; chunkIt < chunkCount; chunkIt++)
+		uniqueOffsets[chunkIt + 1] += uniqueOffsets[chunkIt];
+
+	outValues.resize(uniqueOffsets[chunkCount]);
+
+	jobSystem.parallelFor(chunkCount, [&](uint32_t chunkIt)
+	{
+		uint32_t uniqueIt = uniqueOffsets[chunkIt];
+		for (uint32_t valueIt = chunkIt * chunkSize; valueIt < getChunkEnd(chunkIt); valueIt++)
+		{
+			if (firstOccurrences[valueIt] == valueIt)
+			{
+				outValues[uniqueIt] = makeValue(valueIt);
+				outIndices[valueIt] = uniqueIt++;
+			}
+		}
+	});
+
+	jobSystem.parallelFor(chunkCount, [&](uint32_t chunkIt)
+	{
+		for (uint32_t valueIt = chunkIt * chunkSize; valueIt < getChunkEnd(chunkIt); valueIt++)
+		{
+			uint32_t firstIt = firstOccurrences[valueIt];
+			if (firstIt != valueIt)
+				outIndices[valueIt] = outIndices[firstIt];
+		}
+	});
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// 64-bit hash of size bytes (MurmurHash3 style mixing, one 8 byte word at a time).
+inline uint64_t hashData(const void* data, size_t size, uint64_t seed = 0)
+{
+	auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+	auto mixWord = [&rotl](uint64_t hash, uint64_t word)
+	{
+		word *= 0x87c37b91114253d5ull;
+		word = rotl(word, 31);
+		word *= 0x4cf5ad432745937full;
+		hash ^= word;
+		return rotl(hash, 27) * 5 + 0x52dce729;
+	};
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed ^ 0x9e3779b97f4a7c15ull ^ size;
+
+	size_t offset = 0;
+	for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+	{
+		uint64_t word;
+		std::memcpy(&word, bytes + offset, sizeof(uint64_t));
+		hash = mixWord(hash, word);
+	}
+
+	if (offset < size)
+	{
+		uint64_t word = 0;
+		std::memcpy(&word, bytes + offset, size - offset);
+		hash = mixWord(hash, word);
+	}
+
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+// Hash over the object representation of value. Types with padding must be zero initialized
+// before they are filled in.
+template <typename T>
+inline uint64_t hashBytes(const T& value)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	return hashData(&value, sizeof(T));
+}
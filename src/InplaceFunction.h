@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only void() callable stored in a fixed size inline buffer. Never allocates, callables
+// that don't fit are rejected at compile time.
+template <size_t Size = 56>
+class InplaceFunction
+{
+public:
+
+	InplaceFunction() = default;
+
+	template <typename Callable, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, InplaceFunction>>>
+	InplaceFunction(Callable&& callable)
+	{
+		using T = std::decay_t<Callable>;
+
+		static_assert(sizeof(T) <= Size, "Callable does not fit in InplaceFunction storage.");
+		static_assert(alignof(T) <= alignof(std::max_align_t), "Callable is overaligned.");
+
+		new (&myStorage) T(std::forward<Callable>(callable));
+		myOps = &ourOps<T>;
+	}
+
+	InplaceFunction(InplaceFunction&& other) noexcept
+	{
+		moveFrom(other);
+	}
+
+	InplaceFunction& operator=(InplaceFunction&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			moveFrom(other);
+		}
+
+		return *this;
+	}
+
+	InplaceFunction(const InplaceFunction&) = delete;
+	InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+	~InplaceFunction()
+	{
+		reset();
+	}
+
+	inline void operator()()
+	{
+		assert(myOps != nullptr);
+		myOps->invoke(&myStorage);
+	}
+
+	inline explicit operator bool() const { return myOps != nullptr; }
+
+	void reset()
+	{
+		if (myOps)
+		{
+			myOps->destroy(&myStorage);
+			myOps = nullptr;
+		}
+	}
+
+private:
+
+	struct Ops
+	{
+		void (*invoke)(void*);
+		void (*move)(void* dst, void* src);
+		void (*destroy)(void*);
+	};
+
+	template <typename T>
+	static constexpr Ops ourOps =
+	{
+		[](void* callable) { (*static_cast<T*>(callable))(); },
+		[](void* dst, void* src)
+		{
+			new (dst) T(std::move(*static_cast<T*>(src)));
+			static_cast<T*>(src)->~T();
+		},
+		[](void* callable) { static_cast<T*>(callable)->~T(); }
+	};
+
+	void moveFrom(InplaceFunction& other)
+	{
+		if (other.myOps)
+		{
+			other.myOps->move(&myStorage, &other.myStorage);
+			myOps = other.myOps;
+			other.myOps = nullptr;
+		}
+	}
+
+	std::aligned_storage_t<Size, alignof(std::max_align_t)> myStorage;
+	const Ops* myOps = nullptr;
+};
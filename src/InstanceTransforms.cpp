@@ -0,0 +1,191 @@
+#include "InstanceTransforms.h"
+
+#include "Math.h"
+#include "Simd.h"
+
+#include <algorithm>
+
+namespace
+{
+
+constexpr uint32_t Width = SimdFloat::Width;
+
+// InstanceUniforms and InstanceDrawTransform as lanes, padded to whole transposes
+constexpr uint32_t UniformsCount = sizeof(InstanceUniforms) / sizeof(float);
+constexpr uint32_t DrawTransformCount = sizeof(InstanceDrawTransform) / sizeof(float);
+
+constexpr uint32_t padToWidth(uint32_t count)
+{
+	return (count + Width - 1) / Width * Width;
+}
+
+// c = a * b
+void multiply(const float* a, const float* b, float* c)
+{
+	for (uint32_t col = 0; col < 4; col++)
+		for (uint32_t row = 0; row < 4; row++)
+			c[col * 4 + row] = a[row] * b[col * 4] + a[4 + row] * b[col * 4 + 1] +
+				a[8 + row] * b[col * 4 + 2] + a[12 + row] * b[col * 4 + 3];
+}
+
+// writes values [0, count) of lane i to getDestination(i), Width values at a time
+template <typename Function>
+void storeLanes(const SimdFloat* values, uint32_t count, uint32_t laneCount, Function&& getDestination)
+{
+	for (uint32_t first = 0; first < count; first += Width)
+	{
+		SimdFloat rows[Width];
+		std::copy_n(values + first, Width, rows);
+		transpose(rows);
+
+		uint32_t rowSize = std::min(Width, count - first);
+		for (uint32_t laneIt = 0; laneIt < laneCount; laneIt++)
+		{
+			float* destination = getDestination(laneIt) + first;
+
+			if (rowSize == Width)
+			{
+				rows[laneIt].store(destination);
+			}
+			else
+			{
+				alignas(32) float row[Width];
+				rows[laneIt].store(row);
+				std::copy_n(row, rowSize, destination);
+			}
+		}
+	}
+}
+
+} // namespace
+
+void updateInstanceTransforms(
+	const InstanceAnimation& animation,
+	uint32_t begin,
+	uint32_t end,
+	void* uniforms,
+	size_t uniformStride,
+	InstanceDrawTransform* drawTransforms,
+	InstanceVertex* instances)
+{
+	// view and proj are lerps by s, so proj * view = a + s * b + s^2 * c
+	float dView[16], dProj[16];
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		dView[i] = animation.view1[i] - animation.view0[i];
+		dProj[i] = animation.proj1[i] - animation.proj0[i];
+	}
+
+	float a[16], b0[16], b1[16], c[16];
+	multiply(animation.proj0, animation.view0, a);
+	multiply(animation.proj0, dView, b0);
+	multiply(dProj, animation.view0, b1);
+	multiply(dProj, dView, c);
+
+	const float* d = animation.dequantize;
+	const float halfPeriod = 0.5f * animation.period;
+
+	SimdFloat ubo[padToWidth(UniformsCount)] = {};
+	SimdFloat drawTransform[padToWidth(DrawTransformCount)] = {};
+	SimdFloat instance[padToWidth(16)] = {};
+	SimdFloat* model = &ubo[0];
+	SimdFloat* view = &ubo[16];
+	SimdFloat* proj = &ubo[32];
+	SimdFloat* modelViewProj = &drawTransform[0];
+	SimdFloat* cameraPosition = &drawTransform[16];
+
+	for (uint32_t first = begin; first < end; first += Width)
+	{
+		alignas(32) float indices[Width];
+		for (uint32_t laneIt = 0; laneIt < Width; laneIt++)
+			indices[laneIt] = static_cast<float>(first + laneIt);
+
+		// fold the phase into [0, period / 2] and back without branching
+		SimdFloat phase = SimdFloat::load(indices) * animation.phaseStep + animation.time;
+		SimdFloat tp = phase - floor(phase / animation.period) * animation.period;
+		SimdFloat s = smootherstep(smoothstep(clamp(ramp(halfPeriod - abs(tp - halfPeriod), 0, halfPeriod), 0, 1)));
+
+		// model = translate(0, 0, depth) * rotate(s turns around z)
+		SimdFloat cosine = cosTurns(s);
+		SimdFloat sine = sinTurns(s);
+
+		// model * dequantize, column by column
+		for (uint32_t col = 0; col < 4; col++)
+		{
+			const float* dc = &d[col * 4];
+			model[col * 4 + 0] = cosine * dc[0] - sine * dc[1];
+			model[col * 4 + 1] = sine * dc[0] + cosine * dc[1];
+			model[col * 4 + 2] = dc[2] + animation.depth * dc[3];
+			model[col * 4 + 3] = dc[3];
+		}
+
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			view[i] = animation.view0[i] + s * dView[i];
+			proj[i] = animation.proj0[i] + s * dProj[i];
+		}
+
+		// proj * view * model, model only mixes the first two columns and moves along the third
+		SimdFloat projView[16];
+		for (uint32_t i = 0; i < 16; i++)
+			projView[i] = a[i] + s * ((b0[i] + b1[i]) + s * c[i]);
+
+		for (uint32_t row = 0; row < 4; row++)
+		{
+			modelViewProj[row] = cosine * projView[row] + sine * projView[4 + row];
+			modelViewProj[4 + row] = cosine * projView[4 + row] - sine * projView[row];
+			modelViewProj[8 + row] = projView[8 + row];
+			modelViewProj[12 + row] = projView[8 + row] * animation.depth + projView[12 + row];
+		}
+
+		// view is affine, so the camera is at -inverse(mat3(view)) * view[3] in world space,
+		// solved with cramer's rule. r1 x r2, r2 x r0 and r0 x r1 are the rows of the adjugate.
+		SimdFloat x12[3] = {
+			view[5] * view[10] - view[6] * view[9],
+			view[6] * view[8] - view[4] * view[10],
+			view[4] * view[9] - view[5] * view[8] };
+		SimdFloat x20[3] = {
+			view[9] * view[2] - view[10] * view[1],
+			view[10] * view[0] - view[8] * view[2],
+			view[8] * view[1] - view[9] * view[0] };
+		SimdFloat x01[3] = {
+			view[1] * view[6] - view[2] * view[5],
+			view[2] * view[4] - view[0] * view[6],
+			view[0] * view[5] - view[1] * view[4] };
+		SimdFloat scale = -1.0f / (view[0] * x12[0] + view[1] * x12[1] + view[2] * x12[2]);
+		SimdFloat wx = scale * (view[12] * x12[0] + view[13] * x12[1] + view[14] * x12[2]);
+		SimdFloat wy = scale * (view[12] * x20[0] + view[13] * x20[1] + view[14] * x20[2]);
+		SimdFloat wz = scale * (view[12] * x01[0] + view[13] * x01[1] + view[14] * x01[2]);
+
+		// and then through the inverse model into object space
+		cameraPosition[0] = cosine * wx + sine * wy;
+		cameraPosition[1] = cosine * wy - sine * wx;
+		cameraPosition[2] = wz - animation.depth;
+
+		drawTransform[19] = abs(proj[5]);
+
+		uint32_t laneCount = std::min(Width, end - first);
+		storeLanes(ubo, UniformsCount, laneCount, [uniforms, uniformStride, first](uint32_t laneIt)
+		{
+			return reinterpret_cast<float*>(static_cast<char*>(uniforms) + (first + laneIt) * uniformStride);
+		});
+		storeLanes(drawTransform, DrawTransformCount, laneCount, [drawTransforms, first](uint32_t laneIt)
+		{
+			return reinterpret_cast<float*>(&drawTransforms[first + laneIt]);
+		});
+
+		if (!instances)
+			continue;
+
+		// modelViewProj * dequantize
+		for (uint32_t col = 0; col < 4; col++)
+			for (uint32_t row = 0; row < 4; row++)
+				instance[col * 4 + row] = modelViewProj[row] * d[col * 4] + modelViewProj[4 + row] * d[col * 4 + 1] +
+					modelViewProj[8 + row] * d[col * 4 + 2] + modelViewProj[12 + row] * d[col * 4 + 3];
+
+		storeLanes(instance, 16, laneCount, [instances, first](uint32_t laneIt)
+		{
+			return instances[first + laneIt].modelViewProj;
+		});
+	}
+}
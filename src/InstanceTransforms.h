@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// All matrices are column major 4x4, the same layout as glm::mat4, so the kernel doesn't need to
+// agree with the renderer on glm's configuration.
+
+// Everything in the per instance animation that is the same for all instances, evaluated once
+// per frame. Instance n is at phase time + n * phaseStep of a period long back and forth cycle.
+struct InstanceAnimation
+{
+	float view0[16];
+	float view1[16];
+	float proj0[16];
+	float proj1[16];
+	float dequantize[16]; // applied to the model matrix of the uniforms only
+	float time = 0.0f;
+	float period = 10.0f;
+	float phaseStep = 0.0025f;
+	float depth = 0.0f; // z translation of every instance
+};
+
+// head of the uniform buffer slot of an instance
+struct InstanceUniforms
+{
+	float model[16];
+	float view[16];
+	float proj[16];
+};
+
+// relative to the unquantized mesh, for culling on the cpu
+struct InstanceDrawTransform
+{
+	float modelViewProj[16];
+	float cameraPosition[3]; // in object space
+	float projectionScale; // proj[1][1], cot(fov / 2)
+};
+
+// per instance vertex attributes of the instanced draw
+struct InstanceVertex
+{
+	float modelViewProj[16]; // proj * view * model * dequantize
+	uint32_t viewportIndex; // set up once, not written by updateInstanceTransforms
+};
+
+// Writes the uniforms (instance n at uniforms + n * uniformStride) and draw transforms (at
+// drawTransforms[n]) of instances [begin, end), SimdFloat::Width instances at a time, and the
+// instance vertices (at instances[n]) unless instances is null. Disjoint ranges may be updated
+// from different threads.
+void updateInstanceTransforms(
+	const InstanceAnimation& animation,
+	uint32_t begin,
+	uint32_t end,
+	void* uniforms,
+	size_t uniformStride,
+	InstanceDrawTransform* drawTransforms,
+	InstanceVertex* instances = nullptr);
@@ -0,0 +1,130 @@
+#include "JobSystem.h"
+
+#include <cassert>
+
+namespace
+{
+
+struct WorkerContext
+{
+	const JobSystem* jobSystem = nullptr;
+	uint32_t queueIndex = 0;
+};
+
+thread_local WorkerContext t_workerContext;
+
+}
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+	assert(threadCount > 0);
+
+	myQueues.reserve(threadCount);
+	for (uint32_t threadIt = 0; threadIt < threadCount; threadIt++)
+		myQueues.emplace_back(std::make_unique<WorkerQueue>());
+
+	myThreads.reserve(threadCount);
+	for (uint32_t threadIt = 0; threadIt < threadCount; threadIt++)
+		myThreads.emplace_back(&JobSystem::workerMain, this, threadIt);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mySleepMutex);
+		myStopFlag = true;
+	}
+	mySleepCondition.notify_all();
+
+	for (auto& thread : myThreads)
+		thread.join();
+}
+
+uint32_t JobSystem::getCurrentThreadIndex() const
+{
+	return (t_workerContext.jobSystem == this) ? t_workerContext.queueIndex + 1 : 0;
+}
+
+void JobSystem::submit(Job&& job)
+{
+	// jobs spawned from a worker go to its own deque, everything else is spread round robin
+	uint32_t queueIndex = (t_workerContext.jobSystem == this) ? t_workerContext.queueIndex
+		: myNextQueueIndex.fetch_add(1, std::memory_order_relaxed) % myQueues.size();
+
+	myPendingJobCount.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		WorkerQueue& queue = *myQueues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.emplace_back(std::move(job));
+	}
+
+	// take the sleep lock so that a worker can't miss the wakeup between checking and waiting
+	{
+		std::lock_guard<std::mutex> lock(mySleepMutex);
+	}
+	mySleepCondition.notify_one();
+}
+
+void JobSystem::wait(const std::atomic<uint32_t>& counter)
+{
+	uint32_t queueIndex = (t_workerContext.jobSystem == this) ? t_workerContext.queueIndex : 0;
+
+	while (counter.load(std::memory_order_acquire) > 0)
+		if (!tryRunOne(queueIndex))
+			std::this_thread::yield();
+}
+
+bool JobSystem::tryRunOne(uint32_t queueIndex)
+{
+	Job job;
+
+	// own queue first (newest job, likely to be warm in cache), then steal the oldest job from the others
+	for (uint32_t queueIt = 0; queueIt < myQueues.size() && !job; queueIt++)
+	{
+		WorkerQueue& queue = *myQueues[(queueIndex + queueIt) % myQueues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			if (queueIt == 0)
+			{
+				job = std::move(queue.jobs.back());
+				queue.jobs.pop_back();
+			}
+			else
+			{
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+			}
+		}
+	}
+
+	if (!job)
+		return false;
+
+	myPendingJobCount.fetch_sub(1, std::memory_order_relaxed);
+
+	job();
+
+	return true;
+}
+
+void JobSystem::workerMain(uint32_t queueIndex)
+{
+	t_workerContext.jobSystem = this;
+	t_workerContext.queueIndex = queueIndex;
+
+	while (!myStopFlag)
+	{
+		if (tryRunOne(queueIndex))
+			continue;
+
+		std::unique_lock<std::mutex> lock(mySleepMutex);
+		mySleepCondition.wait(lock, [this]
+		{
+			return myStopFlag || myPendingJobCount.load(std::memory_order_acquire) > 0;
+		});
+	}
+
+	t_workerContext = WorkerContext();
+}
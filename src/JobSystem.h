@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads with one job deque per worker.
+// Workers pop their own deque from the back and steal from the front of the others.
+// Threads calling parallelFor/wait help out by running queued jobs instead of blocking.
+class JobSystem
+{
+public:
+
+	using Job = std::function<void()>;
+
+	JobSystem(uint32_t threadCount);
+	~JobSystem();
+
+	inline uint32_t getThreadCount() const { return static_cast<uint32_t>(myThreads.size()); }
+
+	// 1 + the index of the calling worker, 0 on threads that aren't workers of this job system
+	uint32_t getCurrentThreadIndex() const;
+
+	void submit(Job&& job);
+
+	// runs jobs until counter reaches zero
+	void wait(const std::atomic<uint32_t>& counter);
+
+	// calls function(i) for all i in [0, count) and returns when all calls have finished
+	template <typename Function>
+	void parallelFor(uint32_t count, Function&& function)
+	{
+		std::atomic<uint32_t> counter(count);
+
+		for (uint32_t i = 0; i < count; i++)
+			submit([&function, &counter, i]
+			{
+				function(i);
+				counter.fetch_sub(1, std::memory_order_release);
+			});
+
+		wait(counter);
+	}
+
+private:
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	bool tryRunOne(uint32_t queueIndex);
+	void workerMain(uint32_t queueIndex);
+
+	std::vector<std::unique_ptr<WorkerQueue>> myQueues; // count = [threadCount]
+	std::vector<std::thread> myThreads;
+
+	std::mutex mySleepMutex;
+	std::condition_variable mySleepCondition;
+
+	std::atomic<uint32_t> myPendingJobCount = 0;
+	std::atomic<uint32_t> myNextQueueIndex = 0;
+	std::atomic<bool> myStopFlag = false;
+};
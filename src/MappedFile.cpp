@@ -0,0 +1,95 @@
+#include "MappedFile.h"
+
+#if defined(__WINDOWS__)
+#	define NOMINMAX
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include <stdexcept>
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#if defined(__WINDOWS__)
+	myFileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (myFileHandle == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open file.");
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(myFileHandle, &fileSize))
+	{
+		CloseHandle(myFileHandle);
+		throw std::runtime_error("Failed to get file size.");
+	}
+
+	mySize = static_cast<size_t>(fileSize.QuadPart);
+	if (mySize == 0)
+		return;
+
+	myMappingHandle = CreateFileMappingW(myFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (myMappingHandle == nullptr)
+	{
+		CloseHandle(myFileHandle);
+		throw std::runtime_error("Failed to map file.");
+	}
+
+	myData = MapViewOfFile(myMappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (myData == nullptr)
+	{
+		CloseHandle(myMappingHandle);
+		CloseHandle(myFileHandle);
+		throw std::runtime_error("Failed to map file.");
+	}
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("Failed to open file.");
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("Failed to get file size.");
+	}
+
+	mySize = static_cast<size_t>(fileStat.st_size);
+	if (mySize == 0)
+	{
+		close(fd);
+		return;
+	}
+
+	myData = mmap(nullptr, mySize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps its own reference to the file
+
+	if (myData == MAP_FAILED)
+	{
+		myData = nullptr;
+		throw std::runtime_error("Failed to map file.");
+	}
+
+	// chunks are parsed from several threads at once, so ask for read-ahead of the whole file
+	madvise(myData, mySize, MADV_WILLNEED);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(__WINDOWS__)
+	if (myData)
+		UnmapViewOfFile(myData);
+	if (myMappingHandle)
+		CloseHandle(myMappingHandle);
+	if (myFileHandle && myFileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(myFileHandle);
+#else
+	if (myData)
+		munmap(myData, mySize);
+#endif
+}
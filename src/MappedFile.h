@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+// Read only memory mapping of a whole file. Throws std::runtime_error if the file can't be mapped.
+class MappedFile
+{
+public:
+
+	MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	inline const char* data() const { return static_cast<const char*>(myData); }
+	inline size_t size() const { return mySize; }
+
+private:
+
+	void* myData = nullptr;
+	size_t mySize = 0;
+#if defined(__WINDOWS__)
+	void* myFileHandle = nullptr;
+	void* myMappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,85 @@
+#include "MeshFile.h"
+
+#include <fstream>
+#include <system_error>
+
+MeshFile::MeshFile(const std::filesystem::path& path)
+	: myFile(path)
+{
+	if (myFile.size() < sizeof(MeshFileHeader))
+		return;
+
+	const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(myFile.data());
+	if (header->magic != MeshFileHeader::Magic || header->version != MeshFileHeader::Version)
+		return;
+
+	for (const auto& blob : header->blobs)
+	{
+		if (blob.offset % MeshFileHeader::BlobAlignment != 0 ||
+			blob.offset > myFile.size() ||
+			blob.size > myFile.size() - blob.offset ||
+			blob.size != uint64_t(blob.elementSize) * blob.elementCount)
+			return;
+	}
+
+	myHeader = header;
+}
+
+bool writeMeshFile(const std::filesystem::path& path, MeshFileHeader header, const MeshFileBlobData (&blobs)[MeshBlob::Count])
+{
+	auto alignUp = [](uint64_t offset) { return (offset + MeshFileHeader::BlobAlignment - 1) & ~(MeshFileHeader::BlobAlignment - 1); };
+
+	header.magic = MeshFileHeader::Magic;
+	header.version = MeshFileHeader::Version;
+
+	uint64_t offset = alignUp(sizeof(MeshFileHeader));
+	for (uint32_t blobIt = 0; blobIt < MeshBlob::Count; blobIt++)
+	{
+		MeshFileBlob& blob = header.blobs[blobIt];
+		blob.offset = offset;
+		blob.elementSize = blobs[blobIt].elementSize;
+		blob.elementCount = blobs[blobIt].elementCount;
+		blob.size = uint64_t(blob.elementSize) * blob.elementCount;
+
+		offset = alignUp(offset + blob.size);
+	}
+
+	std::filesystem::path tempPath(path);
+	tempPath += ".tmp";
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		static const char zeros[MeshFileHeader::BlobAlignment] = {};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(zeros, header.blobs[0].offset - sizeof(header));
+
+		for (uint32_t blobIt = 0; blobIt < MeshBlob::Count; blobIt++)
+		{
+			const MeshFileBlob& blob = header.blobs[blobIt];
+			file.write(static_cast<const char*>(blobs[blobIt].data), blob.size);
+			file.write(zeros, alignUp(blob.offset + blob.size) - (blob.offset + blob.size));
+		}
+
+		if (!file)
+		{
+			file.close();
+			std::error_code error;
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Cooked mesh container. A fixed size header is followed by blobs aligned to
+// MeshFileHeader::BlobAlignment, so a mapped file can be copied straight into staging memory.
+struct MeshBlob
+{
+	enum : uint32_t
+	{
+		Vertices,
+		Indices,
+		Meshlets,
+		Lods,
+
+		Count
+	};
+};
+
+// Level of detail, a range of the index blob and of the meshlet blob. error is how far the
+// surface may be from the full detail mesh, in object space units.
+struct MeshLod
+{
+	static constexpr uint32_t MaxCount = 8;
+
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	float error;
+};
+
+struct MeshFileBlob
+{
+	uint64_t offset = 0; // from start of file
+	uint64_t size = 0; // bytes, == elementSize * elementCount
+	uint32_t elementSize = 0;
+	uint32_t elementCount = 0;
+};
+
+struct MeshFileHeader
+{
+	static constexpr uint32_t Magic = 0x48534d56; // "VMSH"
+	static constexpr uint32_t Version = 4; // bump on any layout change of the header or the blob contents
+	static constexpr uint32_t MaxBlobCount = 16;
+	static constexpr uint64_t BlobAlignment = 64;
+
+	uint32_t magic = Magic;
+	uint32_t version = Version;
+	uint64_t sourceHash = 0; // hashData() of the source file contents
+	float boundsMin[3] = {}; // of the vertex positions, before any quantization
+	float boundsMax[3] = {};
+	MeshFileBlob blobs[MaxBlobCount] = {};
+};
+
+static_assert(MeshBlob::Count <= MeshFileHeader::MaxBlobCount);
+
+// Read only view of a mapped cooked mesh file. Files with the wrong magic or version, or with
+// blobs outside of the file, are reported by isValid() instead of throwing, so that callers
+// can fall back to cooking the source again.
+class MeshFile
+{
+public:
+
+	MeshFile(const std::filesystem::path& path);
+
+	inline bool isValid() const { return myHeader != nullptr; }
+	inline const MeshFileHeader& getHeader() const { return *myHeader; }
+	inline const MeshFileBlob& getBlob(uint32_t blob) const { return myHeader->blobs[blob]; }
+	inline const void* getBlobData(uint32_t blob) const { return myFile.data() + myHeader->blobs[blob].offset; }
+
+private:
+
+	MappedFile myFile;
+	const MeshFileHeader* myHeader = nullptr;
+};
+
+struct MeshFileBlobData
+{
+	const void* data = nullptr;
+	uint32_t elementSize = 0;
+	uint32_t elementCount = 0;
+};
+
+// Writes header (with the blob directory filled in from blobs) and blobs through a temporary file
+// that is renamed into place, so readers never see a partially written file. Returns false if the
+// file could not be written.
+bool writeMeshFile(const std::filesystem::path& path, MeshFileHeader header, const MeshFileBlobData (&blobs)[MeshBlob::Count]);
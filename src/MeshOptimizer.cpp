@@ -0,0 +1,412 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t InvalidIndex = ~0u;
+
+constexpr uint32_t ForsythCacheSize = 32;
+constexpr uint32_t ForsythMaxValence = 32; // scores are the same above this
+
+struct ForsythScoreTables
+{
+	ForsythScoreTables()
+	{
+		// the last triangle is always in the cache, but it's best not to reuse it right away
+		for (uint32_t position = 0; position < ForsythCacheSize; position++)
+			cache[position] = position < 3 ? 0.75f : std::pow(1.0f - float(position - 3) / float(ForsythCacheSize - 3), 1.5f);
+
+		// vertices with few remaining triangles are preferred, to get rid of them early
+		valence[0] = 0.0f;
+		for (uint32_t valenceIt = 1; valenceIt <= ForsythMaxValence; valenceIt++)
+			valence[valenceIt] = 2.0f / std::sqrt(float(valenceIt));
+	}
+
+	inline float getVertexScore(uint32_t cachePosition, uint32_t vertexValence) const
+	{
+		if (vertexValence == 0)
+			return -1.0f; // no triangles left, will never be picked
+
+		float score = valence[std::min(vertexValence, ForsythMaxValence)];
+		if (cachePosition != InvalidIndex)
+			score += cache[cachePosition];
+
+		return score;
+	}
+
+	float cache[ForsythCacheSize];
+	float valence[ForsythMaxValence + 1];
+};
+
+class FifoCache
+{
+public:
+
+	FifoCache(size_t vertexCount, uint32_t cacheSize)
+		: myTimestamps(vertexCount, 0)
+		, myCacheSize(cacheSize)
+	{ }
+
+	// returns true on a miss
+	inline bool access(uint32_t vertex)
+	{
+		if (myTimestamps[vertex] != 0 && myTime - myTimestamps[vertex] < myCacheSize)
+			return false;
+
+		myTimestamps[vertex] = ++myTime;
+		return true;
+	}
+
+	// invalidates all entries without touching the timestamps
+	inline void flush() { myTime += myCacheSize; }
+
+private:
+
+	std::vector<uint32_t> myTimestamps; // insertion time, 0 if never inserted
+	uint32_t myTime = 0;
+	uint32_t myCacheSize = 0;
+};
+
+}
+
+VertexCacheStatistics analyzeVertexCache(
+	const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	assert(indexCount % 3 == 0);
+
+	VertexCacheStatistics result;
+	if (indexCount == 0)
+		return result;
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	size_t referencedCount = 0;
+	size_t missCount = 0;
+
+	for (size_t indexIt = 0; indexIt < indexCount; indexIt++)
+	{
+		uint32_t vertex = indices[indexIt];
+		missCount += cache.access(vertex);
+
+		if (!referenced[vertex])
+		{
+			referenced[vertex] = true;
+			referencedCount++;
+		}
+	}
+
+	result.acmr = float(missCount) / float(indexCount / 3);
+	result.atvr = float(missCount) / float(referencedCount);
+
+	return result;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	assert(indexCount % 3 == 0);
+
+	constexpr uint32_t cacheSize = ForsythCacheSize;
+
+	static const ForsythScoreTables ourScoreTables;
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// vertex -> triangle adjacency, the first valence entries of each range are the remaining triangles
+	std::vector<uint32_t> valences(vertexCount, 0);
+	for (size_t indexIt = 0; indexIt < indexCount; indexIt++)
+		valences[indices[indexIt]]++;
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+		adjacencyOffsets[vertexIt + 1] = adjacencyOffsets[vertexIt] + valences[vertexIt];
+
+	std::vector<uint32_t> adjacency(indexCount);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t indexIt = 0; indexIt < indexCount; indexIt++)
+			adjacency[fill[indices[indexIt]]++] = static_cast<uint32_t>(indexIt / 3);
+	}
+
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+		vertexScores[vertexIt] = ourScoreTables.getVertexScore(InvalidIndex, valences[vertexIt]);
+
+	std::vector<uint32_t> input(indices, indices + indexCount);
+	std::vector<bool> emitted(triangleCount, false);
+
+	uint32_t cache[cacheSize + 3];
+	uint32_t cacheCount = 0;
+
+	size_t outputIndexIt = 0;
+	size_t inputCursor = 0;
+	uint32_t bestTriangle = 0;
+
+	while (bestTriangle != InvalidIndex)
+	{
+		const uint32_t* triangle = &input[bestTriangle * 3];
+
+		emitted[bestTriangle] = true;
+		indices[outputIndexIt++] = triangle[0];
+		indices[outputIndexIt++] = triangle[1];
+		indices[outputIndexIt++] = triangle[2];
+
+		// new cache: the emitted vertices first, then the old contents minus those
+		uint32_t newCache[cacheSize + 3];
+		uint32_t newCacheCount = 0;
+
+		for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+		{
+			uint32_t vertex = triangle[cornerIt];
+			newCache[newCacheCount++] = vertex;
+
+			uint32_t* vertexAdjacency = &adjacency[adjacencyOffsets[vertex]];
+			uint32_t& valence = valences[vertex];
+			for (uint32_t adjacencyIt = 0; adjacencyIt < valence; adjacencyIt++)
+			{
+				if (vertexAdjacency[adjacencyIt] == bestTriangle)
+				{
+					vertexAdjacency[adjacencyIt] = vertexAdjacency[--valence];
+					break;
+				}
+			}
+		}
+
+		for (uint32_t cacheIt = 0; cacheIt < cacheCount; cacheIt++)
+		{
+			uint32_t vertex = cache[cacheIt];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				newCache[newCacheCount++] = vertex;
+		}
+
+		// vertices that fell out of the cache
+		for (uint32_t cacheIt = cacheSize; cacheIt < newCacheCount; cacheIt++)
+		{
+			uint32_t vertex = newCache[cacheIt];
+			vertexScores[vertex] = ourScoreTables.getVertexScore(InvalidIndex, valences[vertex]);
+		}
+
+		cacheCount = std::min(newCacheCount, cacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		for (uint32_t cacheIt = 0; cacheIt < cacheCount; cacheIt++)
+		{
+			uint32_t vertex = cache[cacheIt];
+			vertexScores[vertex] = ourScoreTables.getVertexScore(cacheIt, valences[vertex]);
+		}
+
+		// only triangles touching the cache can have changed scores, pick the best of those
+		bestTriangle = InvalidIndex;
+		float bestScore = 0.0f;
+
+		for (uint32_t cacheIt = 0; cacheIt < cacheCount; cacheIt++)
+		{
+			uint32_t vertex = cache[cacheIt];
+			const uint32_t* vertexAdjacency = &adjacency[adjacencyOffsets[vertex]];
+
+			for (uint32_t adjacencyIt = 0; adjacencyIt < valences[vertex]; adjacencyIt++)
+			{
+				uint32_t triangleIt = vertexAdjacency[adjacencyIt];
+				const uint32_t* adjacentTriangle = &input[triangleIt * 3];
+
+				float score = vertexScores[adjacentTriangle[0]] + vertexScores[adjacentTriangle[1]] + vertexScores[adjacentTriangle[2]];
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = triangleIt;
+				}
+			}
+		}
+
+		// dead end, continue with the next triangle in input order
+		if (bestTriangle == InvalidIndex)
+		{
+			while (inputCursor < triangleCount && emitted[inputCursor])
+				inputCursor++;
+
+			if (inputCursor < triangleCount)
+				bestTriangle = static_cast<uint32_t>(inputCursor);
+		}
+	}
+
+	assert(outputIndexIt == indexCount);
+}
+
+void optimizeOverdraw(
+	uint32_t* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount,
+	float threshold)
+{
+	assert(indexCount % 3 == 0);
+
+	constexpr uint32_t cacheSize = 16;
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	auto getPosition = [positions, positionStride](uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * positionStride);
+	};
+
+	// hard boundaries where the cache is effectively flushed, i.e. all three vertices miss
+	std::vector<uint32_t> clusterBegins;
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		for (size_t triangleIt = 0; triangleIt < triangleCount; triangleIt++)
+		{
+			const uint32_t* triangle = &indices[triangleIt * 3];
+			uint32_t missCount = cache.access(triangle[0]) + cache.access(triangle[1]) + cache.access(triangle[2]);
+
+			if (triangleIt == 0 || missCount == 3)
+				clusterBegins.push_back(static_cast<uint32_t>(triangleIt));
+		}
+		clusterBegins.push_back(static_cast<uint32_t>(triangleCount));
+	}
+
+	// soft boundaries inside each hard cluster, wherever the running ACMR is within threshold of the cluster's
+	{
+		std::vector<uint32_t> softClusterBegins;
+		FifoCache cache(vertexCount, cacheSize);
+
+		for (size_t clusterIt = 0; clusterIt + 1 < clusterBegins.size(); clusterIt++)
+		{
+			uint32_t begin = clusterBegins[clusterIt];
+			uint32_t end = clusterBegins[clusterIt + 1];
+
+			cache.flush();
+			uint32_t clusterMissCount = 0;
+			for (uint32_t triangleIt = begin; triangleIt < end; triangleIt++)
+				for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+					clusterMissCount += cache.access(indices[triangleIt * 3 + cornerIt]);
+
+			float clusterAcmr = float(clusterMissCount) / float(end - begin);
+
+			cache.flush();
+			softClusterBegins.push_back(begin);
+
+			uint32_t missCount = 0;
+			uint32_t softBegin = begin;
+			for (uint32_t triangleIt = begin; triangleIt < end; triangleIt++)
+			{
+				for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+					missCount += cache.access(indices[triangleIt * 3 + cornerIt]);
+
+				if (triangleIt + 1 < end && float(missCount) / float(triangleIt + 1 - softBegin) <= threshold * clusterAcmr)
+				{
+					softClusterBegins.push_back(triangleIt + 1);
+					softBegin = triangleIt + 1;
+					missCount = 0;
+					cache.flush();
+				}
+			}
+		}
+
+		softClusterBegins.push_back(static_cast<uint32_t>(triangleCount));
+		clusterBegins.swap(softClusterBegins);
+	}
+
+	size_t clusterCount = clusterBegins.size() - 1;
+
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t indexIt = 0; indexIt < indexCount; indexIt++)
+	{
+		const float* position = getPosition(indices[indexIt]);
+		meshCentroid[0] += position[0];
+		meshCentroid[1] += position[1];
+		meshCentroid[2] += position[2];
+	}
+	for (float& component : meshCentroid)
+		component /= float(indexCount);
+
+	// clusters facing away from the mesh center are likely to occlude the others, draw those first
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t clusterIt = 0; clusterIt < clusterCount; clusterIt++)
+	{
+		float centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+
+		for (uint32_t triangleIt = clusterBegins[clusterIt]; triangleIt < clusterBegins[clusterIt + 1]; triangleIt++)
+		{
+			const float* p0 = getPosition(indices[triangleIt * 3 + 0]);
+			const float* p1 = getPosition(indices[triangleIt * 3 + 1]);
+			const float* p2 = getPosition(indices[triangleIt * 3 + 2]);
+
+			float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+			float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (uint32_t axisIt = 0; axisIt < 3; axisIt++)
+			{
+				centroid[axisIt] += (p0[axisIt] + p1[axisIt] + p2[axisIt]) * (triangleArea / 3.0f);
+				normal[axisIt] += n[axisIt];
+			}
+			area += triangleArea;
+		}
+
+		float invArea = area == 0.0f ? 0.0f : 1.0f / area;
+		float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float invNormalLength = normalLength == 0.0f ? 0.0f : 1.0f / normalLength;
+
+		float sortKey = 0.0f;
+		for (uint32_t axisIt = 0; axisIt < 3; axisIt++)
+			sortKey += (centroid[axisIt] * invArea - meshCentroid[axisIt]) * normal[axisIt] * invNormalLength;
+
+		sortKeys[clusterIt] = sortKey;
+	}
+
+	std::vector<uint32_t> clusterOrder(clusterCount);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&sortKeys](uint32_t a, uint32_t b)
+	{
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<uint32_t> input(indices, indices + indexCount);
+	size_t outputIndexIt = 0;
+	for (uint32_t clusterIt : clusterOrder)
+	{
+		size_t begin = clusterBegins[clusterIt] * 3;
+		size_t end = clusterBegins[clusterIt + 1] * 3;
+		std::copy(input.begin() + begin, input.begin() + end, indices + outputIndexIt);
+		outputIndexIt += end - begin;
+	}
+}
+
+size_t optimizeVertexFetch(
+	void* vertices, size_t vertexCount, size_t vertexSize,
+	uint32_t* indices, size_t indexCount)
+{
+	std::vector<uint32_t> remap(vertexCount, InvalidIndex);
+	uint32_t newVertexCount = 0;
+
+	for (size_t indexIt = 0; indexIt < indexCount; indexIt++)
+	{
+		uint32_t& newVertex = remap[indices[indexIt]];
+		if (newVertex == InvalidIndex)
+			newVertex = newVertexCount++;
+
+		indices[indexIt] = newVertex;
+	}
+
+	std::vector<char> input(static_cast<const char*>(vertices), static_cast<const char*>(vertices) + vertexCount * vertexSize);
+	for (size_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+	{
+		if (remap[vertexIt] != InvalidIndex)
+			std::memcpy(static_cast<char*>(vertices) + remap[vertexIt] * vertexSize, &input[vertexIt * vertexSize], vertexSize);
+	}
+
+	return newVertexCount;
+}
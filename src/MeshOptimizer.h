@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Post transform vertex cache statistics of a triangle list, simulated with a FIFO cache.
+struct VertexCacheStatistics
+{
+	float acmr = 0.0f; // average cache miss ratio, transformed vertices per triangle (0.5 - 3.0)
+	float atvr = 0.0f; // average transformed to vertex ratio, transformed vertices per referenced vertex (1.0 - 6.0)
+};
+
+VertexCacheStatistics analyzeVertexCache(
+	const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Reorders triangles for post transform cache locality (Forsyth, "Linear-Speed Vertex Cache
+// Optimisation").
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Splits a cache optimized triangle list into clusters wherever the cache hit rate allows it,
+// and sorts the clusters so that outward facing ones are drawn first (Sander et al., "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw"). threshold is how much worse
+// than the input ACMR the result may get, 1.05 allows 5%.
+void optimizeOverdraw(
+	uint32_t* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount,
+	float threshold = 1.05f);
+
+// Reorders vertices in order of first use and remaps indices to match. Unreferenced vertices
+// are dropped, returns the new vertex count.
+size_t optimizeVertexFetch(
+	void* vertices, size_t vertexCount, size_t vertexSize,
+	uint32_t* indices, size_t indexCount);
@@ -0,0 +1,512 @@
+#include "MeshSimplify.h"
+
+#include "Deduplicate.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t InvalidIndex = ~0u;
+
+struct Float3
+{
+	float x, y, z;
+
+	Float3 operator+(const Float3& other) const { return { x + other.x, y + other.y, z + other.z }; }
+	Float3 operator-(const Float3& other) const { return { x - other.x, y - other.y, z - other.z }; }
+	Float3 operator*(float scale) const { return { x * scale, y * scale, z * scale }; }
+};
+
+inline float dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float length(const Float3& a) { return std::sqrt(dot(a, a)); }
+inline Float3 cross(const Float3& a, const Float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+enum VertexKind : uint8_t
+{
+	Manifold, // no seam, no open edges
+	Border, // one open edge loop through the vertex
+	Seam, // two vertices with the same position, split by one attribute seam
+	Locked, // anything more complicated, never moved
+
+	KindCount
+};
+
+// can a vertex of the first kind collapse into a vertex of the second kind
+constexpr bool CanCollapse[KindCount][KindCount] =
+{
+	{ true, true, true, true },
+	{ false, true, false, false },
+	{ false, false, true, false },
+	{ false, false, false, false },
+};
+
+// do edges between these kinds have a twin half edge in position space
+constexpr bool HasOpposite[KindCount][KindCount] =
+{
+	{ true, true, true, false },
+	{ true, false, true, false },
+	{ true, true, true, false },
+	{ false, false, false, false },
+};
+
+constexpr float BorderWeight = 10.0f;
+constexpr float SeamWeight = 1.0f;
+
+// Sum of squared distances to a set of weighted planes, v'Av + 2b'v + c.
+struct Quadric
+{
+	float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f;
+	float a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+	float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+	float c = 0.0f;
+	float weight = 0.0f;
+
+	Quadric() = default;
+
+	Quadric(const Float3& normal, float distance, float planeWeight)
+		: a00(normal.x * normal.x * planeWeight)
+		, a11(normal.y * normal.y * planeWeight)
+		, a22(normal.z * normal.z * planeWeight)
+		, a10(normal.x * normal.y * planeWeight)
+		, a20(normal.x * normal.z * planeWeight)
+		, a21(normal.y * normal.z * planeWeight)
+		, b0(normal.x * distance * planeWeight)
+		, b1(normal.y * distance * planeWeight)
+		, b2(normal.z * distance * planeWeight)
+		, c(distance * distance * planeWeight)
+		, weight(planeWeight)
+	{ }
+
+	Quadric& operator+=(const Quadric& other)
+	{
+		a00 += other.a00; a11 += other.a11; a22 += other.a22;
+		a10 += other.a10; a20 += other.a20; a21 += other.a21;
+		b0 += other.b0; b1 += other.b1; b2 += other.b2;
+		c += other.c;
+		weight += other.weight;
+		return *this;
+	}
+
+	// weighted average squared distance of v to the planes
+	float getError(const Float3& v) const
+	{
+		float rx = 2.0f * (b0 + a10 * v.y) + a00 * v.x;
+		float ry = 2.0f * (b1 + a21 * v.z) + a11 * v.y;
+		float rz = 2.0f * (b2 + a20 * v.x) + a22 * v.z;
+		float r = c + rx * v.x + ry * v.y + rz * v.z;
+
+		return weight > 0.0f ? std::fabs(r) / weight : 0.0f;
+	}
+};
+
+// Per vertex lists of the triangles (or outgoing half edges) around it, in one array.
+struct VertexAdjacency
+{
+	// keys maps each index to the vertex the lists are kept for, nullptr for the indices themselves
+	VertexAdjacency(const uint32_t* indices, size_t indexCount, const uint32_t* keys, size_t vertexCount)
+		: offsets(vertexCount + 1, 0)
+		, items(indexCount)
+	{
+		auto getKey = [keys](uint32_t index) { return keys ? keys[index] : index; };
+
+		for (size_t indexIt = 0; indexIt < indexCount; indexIt++)
+			offsets[getKey(indices[indexIt]) + 1]++;
+
+		for (size_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+			offsets[vertexIt + 1] += offsets[vertexIt];
+
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+		for (size_t indexIt = 0; indexIt < indexCount; indexIt++)
+		{
+			size_t triangle = indexIt / 3;
+			size_t next = triangle * 3 + (indexIt + 1) % 3;
+
+			// triangles when keyed, otherwise the vertex at the end of the half edge
+			items[fill[getKey(indices[indexIt])]++] = keys ? static_cast<uint32_t>(triangle) : indices[next];
+		}
+	}
+
+	inline const uint32_t* begin(uint32_t vertex) const { return items.data() + offsets[vertex]; }
+	inline const uint32_t* end(uint32_t vertex) const { return items.data() + offsets[vertex + 1]; }
+
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> items;
+};
+
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	float error;
+};
+
+// would moving position group from onto the position of to turn any remaining triangle around it over
+bool hasTriangleFlips(
+	const VertexAdjacency& triangles,
+	const uint32_t* indices,
+	const std::vector<Float3>& positions,
+	const std::vector<uint32_t>& remap,
+	const std::vector<uint32_t>& collapseRemap,
+	uint32_t from, uint32_t to)
+{
+	uint32_t fromKey = remap[from];
+	uint32_t toKey = remap[to];
+
+	for (const uint32_t* triangleIt = triangles.begin(fromKey); triangleIt != triangles.end(fromKey); triangleIt++)
+	{
+		uint32_t corners[3];
+		for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+			corners[cornerIt] = collapseRemap[indices[*triangleIt * 3 + cornerIt]];
+
+		// triangles on the edge itself disappear
+		if (remap[corners[0]] == toKey || remap[corners[1]] == toKey || remap[corners[2]] == toKey)
+			continue;
+
+		Float3 before[3];
+		Float3 after[3];
+		for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+		{
+			before[cornerIt] = positions[corners[cornerIt]];
+			after[cornerIt] = remap[corners[cornerIt]] == fromKey ? positions[to] : before[cornerIt];
+		}
+
+		Float3 normalBefore = cross(before[1] - before[0], before[2] - before[0]);
+		Float3 normalAfter = cross(after[1] - after[0], after[2] - after[0]);
+
+		if (dot(normalBefore, normalBefore) > 0.0f && dot(normalBefore, normalAfter) <= 0.0f)
+			return true;
+	}
+
+	return false;
+}
+
+}
+
+float getMeshScale(const float* positions, size_t positionStride, size_t vertexCount)
+{
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (size_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+	{
+		const float* position = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertexIt * positionStride);
+		for (uint32_t axisIt = 0; axisIt < 3; axisIt++)
+		{
+			boundsMin[axisIt] = std::min(boundsMin[axisIt], position[axisIt]);
+			boundsMax[axisIt] = std::max(boundsMax[axisIt], position[axisIt]);
+		}
+	}
+
+	float scale = 0.0f;
+	for (uint32_t axisIt = 0; axisIt < 3; axisIt++)
+		scale = std::max(scale, boundsMax[axisIt] - boundsMin[axisIt]);
+
+	return scale;
+}
+
+size_t simplifyMesh(
+	uint32_t* destination,
+	const uint32_t* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount,
+	size_t targetIndexCount, float targetError, float* outError)
+{
+	assert(indexCount % 3 == 0);
+
+	if (destination != indices)
+		std::copy_n(indices, indexCount, destination);
+
+	uint32_t* result = destination;
+	size_t resultCount = indexCount;
+
+	// positions in units of the mesh extent, so that errors are relative
+	std::vector<Float3> vertexPositions(vertexCount);
+	{
+		float scale = getMeshScale(positions, positionStride, vertexCount);
+		float invScale = scale > 0.0f ? 1.0f / scale : 0.0f;
+
+		for (size_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+		{
+			const float* position = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertexIt * positionStride);
+			vertexPositions[vertexIt] = Float3{ position[0], position[1], position[2] } * invScale;
+		}
+	}
+
+	// vertices sharing a position remap to the first of them, and wedge links them in a ring
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint32_t> wedge(vertexCount);
+	{
+		HashIndexTable table(vertexCount);
+
+		for (uint32_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+		{
+			const Float3& position = vertexPositions[vertexIt];
+			remap[vertexIt] = table.findOrInsert(hashBytes(position), vertexIt, [&vertexPositions, &position](uint32_t other)
+			{
+				return std::memcmp(&vertexPositions[other], &position, sizeof(Float3)) == 0;
+			});
+
+			wedge[vertexIt] = vertexIt;
+			if (remap[vertexIt] != vertexIt)
+			{
+				wedge[vertexIt] = wedge[remap[vertexIt]];
+				wedge[remap[vertexIt]] = vertexIt;
+			}
+		}
+	}
+
+	// loop is the open half edge leaving each vertex, or the vertex itself if there are several
+	std::vector<uint8_t> kinds(vertexCount, Manifold);
+	std::vector<uint32_t> loop(vertexCount, InvalidIndex);
+	{
+		VertexAdjacency edges(result, resultCount, nullptr, vertexCount);
+		std::vector<uint32_t> loopBack(vertexCount, InvalidIndex);
+
+		auto hasEdge = [&edges](uint32_t from, uint32_t to)
+		{
+			return std::find(edges.begin(from), edges.end(from), to) != edges.end(from);
+		};
+
+		for (uint32_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+		{
+			for (const uint32_t* edgeIt = edges.begin(vertexIt); edgeIt != edges.end(vertexIt); edgeIt++)
+			{
+				uint32_t target = *edgeIt;
+				if (hasEdge(target, vertexIt))
+					continue;
+
+				loopBack[target] = loopBack[target] == InvalidIndex ? vertexIt : target;
+				loop[vertexIt] = loop[vertexIt] == InvalidIndex ? target : vertexIt;
+			}
+		}
+
+		auto hasSingleOpenEdge = [&loop, &loopBack](uint32_t vertex)
+		{
+			return loop[vertex] != InvalidIndex && loop[vertex] != vertex &&
+				loopBack[vertex] != InvalidIndex && loopBack[vertex] != vertex;
+		};
+
+		// remap points backwards, so the first vertex of every position is classified first
+		for (uint32_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+		{
+			if (remap[vertexIt] != vertexIt)
+			{
+				kinds[vertexIt] = kinds[remap[vertexIt]];
+			}
+			else if (wedge[vertexIt] == vertexIt)
+			{
+				if (loop[vertexIt] == InvalidIndex && loopBack[vertexIt] == InvalidIndex)
+					kinds[vertexIt] = Manifold;
+				else if (hasSingleOpenEdge(vertexIt))
+					kinds[vertexIt] = Border;
+				else
+					kinds[vertexIt] = Locked;
+			}
+			else if (wedge[wedge[vertexIt]] == vertexIt)
+			{
+				// the open edges of both sides have to meet up in position space
+				uint32_t other = wedge[vertexIt];
+				if (hasSingleOpenEdge(vertexIt) && hasSingleOpenEdge(other) &&
+					remap[loopBack[vertexIt]] == remap[loop[other]] &&
+					remap[loop[vertexIt]] == remap[loopBack[other]] &&
+					remap[loop[vertexIt]] != remap[loopBack[vertexIt]])
+					kinds[vertexIt] = Seam;
+				else
+					kinds[vertexIt] = Locked;
+			}
+			else
+			{
+				kinds[vertexIt] = Locked;
+			}
+		}
+	}
+
+	// quadrics are kept per position, so both sides of a seam share them
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t indexIt = 0; indexIt < resultCount; indexIt += 3)
+	{
+		const uint32_t* triangle = &result[indexIt];
+		const Float3& p0 = vertexPositions[triangle[0]];
+
+		Float3 normal = cross(vertexPositions[triangle[1]] - p0, vertexPositions[triangle[2]] - p0);
+		float area = length(normal);
+		if (area == 0.0f)
+			continue;
+
+		normal = normal * (1.0f / area);
+
+		// square root of the area keeps the weight in the same unit as the edge weights below
+		Quadric quadric(normal, -dot(normal, p0), std::sqrt(area));
+		for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+			quadrics[remap[triangle[cornerIt]]] += quadric;
+
+		// borders and seams get a plane through the edge, perpendicular to the triangle, to keep them in place
+		for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+		{
+			uint32_t i0 = triangle[cornerIt];
+			uint32_t i1 = triangle[(cornerIt + 1) % 3];
+			uint32_t i2 = triangle[(cornerIt + 2) % 3];
+
+			uint8_t kind = kinds[i0];
+			if (kind != kinds[i1] || (kind != Border && kind != Seam) || loop[i0] != i1)
+				continue;
+
+			Float3 edge = vertexPositions[i1] - vertexPositions[i0];
+			float edgeLength = length(edge);
+			if (edgeLength == 0.0f)
+				continue;
+
+			edge = edge * (1.0f / edgeLength);
+
+			Float3 toOpposite = vertexPositions[i2] - vertexPositions[i0];
+			Float3 edgeNormal = toOpposite - edge * dot(toOpposite, edge);
+			float edgeNormalLength = length(edgeNormal);
+			if (edgeNormalLength == 0.0f)
+				continue;
+
+			edgeNormal = edgeNormal * (1.0f / edgeNormalLength);
+
+			Quadric edgeQuadric(edgeNormal, -dot(edgeNormal, vertexPositions[i0]), edgeLength * (kind == Border ? BorderWeight : SeamWeight));
+			quadrics[remap[i0]] += edgeQuadric;
+			quadrics[remap[i1]] += edgeQuadric;
+		}
+	}
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> collapseRemap(vertexCount);
+	std::vector<uint8_t> collapseLocked(vertexCount);
+
+	float errorLimit = targetError * targetError;
+	float resultError = 0.0f;
+
+	// every pass does a batch of independent collapses, cheapest first
+	while (resultCount > targetIndexCount)
+	{
+		VertexAdjacency triangles(result, resultCount, remap.data(), vertexCount);
+
+		collapses.clear();
+		for (size_t indexIt = 0; indexIt < resultCount; indexIt++)
+		{
+			uint32_t i0 = result[indexIt];
+			uint32_t i1 = result[indexIt - indexIt % 3 + (indexIt + 1) % 3];
+
+			uint8_t k0 = kinds[i0];
+			uint8_t k1 = kinds[i1];
+
+			if (!CanCollapse[k0][k1] && !CanCollapse[k1][k0])
+				continue;
+
+			// twin half edges would add the same candidate twice
+			if (HasOpposite[k0][k1] && remap[i1] > remap[i0])
+				continue;
+
+			// border and seam vertices only move along their own edge loop
+			if (k0 == k1 && (k0 == Border || k0 == Seam) && loop[i0] != i1)
+				continue;
+
+			float error01 = CanCollapse[k0][k1] ? quadrics[remap[i0]].getError(vertexPositions[i1]) : FLT_MAX;
+			float error10 = CanCollapse[k1][k0] ? quadrics[remap[i1]].getError(vertexPositions[i0]) : FLT_MAX;
+
+			collapses.push_back(error01 <= error10 ? Collapse{ i0, i1, error01 } : Collapse{ i1, i0, error10 });
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		for (uint32_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+			collapseRemap[vertexIt] = vertexIt;
+
+		std::fill(collapseLocked.begin(), collapseLocked.end(), 0);
+
+		size_t triangleCollapseGoal = (resultCount - targetIndexCount) / 3;
+		size_t edgeCollapseGoal = triangleCollapseGoal / 2;
+
+		size_t triangleCollapseCount = 0;
+		size_t edgeCollapseCount = 0;
+		size_t skipCount = 0;
+
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.error > errorLimit || triangleCollapseCount >= triangleCollapseGoal)
+				break;
+
+			// don't go much past the error of the collapse that would reach the goal, the next pass may
+			// find cheaper ones. skipped collapses push that one further out, or flipping candidates
+			// that stay at the front of the list would stall every pass.
+			size_t errorGoalIt = edgeCollapseGoal + skipCount;
+			float errorGoal = errorGoalIt < collapses.size() ? 1.5f * collapses[errorGoalIt].error : FLT_MAX;
+			if (collapse.error > errorGoal && triangleCollapseCount > triangleCollapseGoal / 10)
+				break;
+
+			uint32_t r0 = remap[collapse.from];
+			uint32_t r1 = remap[collapse.to];
+
+			if (collapseLocked[r0] || collapseLocked[r1] ||
+				hasTriangleFlips(triangles, result, vertexPositions, remap, collapseRemap, collapse.from, collapse.to))
+			{
+				skipCount++;
+				continue;
+			}
+
+			quadrics[r1] += quadrics[r0];
+
+			collapseRemap[collapse.from] = collapse.to;
+			if (kinds[collapse.from] == Seam)
+				collapseRemap[wedge[collapse.from]] = wedge[collapse.to];
+
+			collapseLocked[r0] = 1;
+			collapseLocked[r1] = 1;
+
+			// a border edge has one triangle, other edges at least two
+			triangleCollapseCount += kinds[collapse.from] == Border ? 1 : 2;
+			edgeCollapseCount++;
+
+			resultError = std::max(resultError, collapse.error);
+		}
+
+		if (edgeCollapseCount == 0)
+			break;
+
+		size_t writeCount = 0;
+		for (size_t indexIt = 0; indexIt < resultCount; indexIt += 3)
+		{
+			uint32_t v0 = collapseRemap[result[indexIt + 0]];
+			uint32_t v1 = collapseRemap[result[indexIt + 1]];
+			uint32_t v2 = collapseRemap[result[indexIt + 2]];
+
+			if (remap[v0] == remap[v1] || remap[v1] == remap[v2] || remap[v2] == remap[v0])
+				continue;
+
+			result[writeCount++] = v0;
+			result[writeCount++] = v1;
+			result[writeCount++] = v2;
+		}
+
+		resultCount = writeCount;
+
+		// keep the loops pointing at live vertices, a loop edge collapsed backwards skips ahead
+		for (uint32_t vertexIt = 0; vertexIt < vertexCount; vertexIt++)
+		{
+			uint32_t next = loop[vertexIt];
+			if (next == InvalidIndex)
+				continue;
+
+			uint32_t target = collapseRemap[next];
+			if (target == vertexIt)
+				loop[vertexIt] = loop[next] != InvalidIndex ? collapseRemap[loop[next]] : InvalidIndex;
+			else
+				loop[vertexIt] = target;
+		}
+	}
+
+	if (outError)
+		*outError = std::sqrt(resultError);
+
+	return resultCount;
+}
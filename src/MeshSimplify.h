@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Simplifies a triangle list by collapsing edges in order of increasing quadric error (Garland
+// and Heckbert, "Surface Simplification Using Quadric Error Metrics"). Only the index buffer is
+// rewritten, the result references a subset of the input vertices.
+//
+// Vertices with the same position but different attributes (seams) and open borders only collapse
+// along the seam or border, so neither tears open. Collapsing stops at targetIndexCount, or when
+// the next collapse would move the surface further than targetError, relative to the largest
+// extent of the mesh. outError receives the error of the result in the same unit.
+//
+// destination may alias indices, and needs room for indexCount indices. Returns the new index count.
+size_t simplifyMesh(
+	uint32_t* destination,
+	const uint32_t* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount,
+	size_t targetIndexCount, float targetError, float* outError = nullptr);
+
+// Largest extent of the bounding box of positions, the unit of simplifyMesh errors.
+float getMeshScale(const float* positions, size_t positionStride, size_t vertexCount);
@@ -0,0 +1,164 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+
+struct Float3
+{
+	float x, y, z;
+
+	Float3 operator+(const Float3& other) const { return { x + other.x, y + other.y, z + other.z }; }
+	Float3 operator-(const Float3& other) const { return { x - other.x, y - other.y, z - other.z }; }
+	Float3 operator*(float scale) const { return { x * scale, y * scale, z * scale }; }
+};
+
+inline float dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float length(const Float3& a) { return std::sqrt(dot(a, a)); }
+inline Float3 cross(const Float3& a, const Float3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+void computeMeshletBounds(
+	const uint32_t* indices,
+	const float* positions, size_t positionStride,
+	const std::vector<uint32_t>& meshletVertices,
+	Meshlet& meshlet)
+{
+	auto getPosition = [positions, positionStride](uint32_t vertex)
+	{
+		const float* position = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * positionStride);
+		return Float3{ position[0], position[1], position[2] };
+	};
+
+	// Ritter's bounding sphere: start from two far apart points, then grow to fit the rest
+	auto getFarthest = [&getPosition, &meshletVertices](const Float3& from)
+	{
+		Float3 farthest = from;
+		float farthestDistance = -1.0f;
+		for (uint32_t vertex : meshletVertices)
+		{
+			Float3 position = getPosition(vertex);
+			float distance = dot(position - from, position - from);
+			if (distance > farthestDistance)
+			{
+				farthest = position;
+				farthestDistance = distance;
+			}
+		}
+		return farthest;
+	};
+
+	Float3 a = getFarthest(getPosition(meshletVertices[0]));
+	Float3 b = getFarthest(a);
+
+	Float3 center = (a + b) * 0.5f;
+	float radius = length(b - a) * 0.5f;
+
+	for (uint32_t vertex : meshletVertices)
+	{
+		Float3 offset = getPosition(vertex) - center;
+		float distance = length(offset);
+		if (distance > radius)
+		{
+			float newRadius = (radius + distance) * 0.5f;
+			center = center + offset * ((newRadius - radius) / distance);
+			radius = newRadius;
+		}
+	}
+
+	// normal cone around the area weighted average normal
+	Float3 axis = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t indexIt = 0; indexIt < meshlet.indexCount; indexIt += 3)
+	{
+		const uint32_t* triangle = &indices[meshlet.firstIndex + indexIt];
+		Float3 p0 = getPosition(triangle[0]);
+		axis = axis + cross(getPosition(triangle[1]) - p0, getPosition(triangle[2]) - p0);
+	}
+
+	float axisLength = length(axis);
+	axis = axisLength > 0.0f ? axis * (1.0f / axisLength) : Float3{ 0.0f, 0.0f, 0.0f };
+
+	float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+	for (uint32_t indexIt = 0; indexIt < meshlet.indexCount; indexIt += 3)
+	{
+		const uint32_t* triangle = &indices[meshlet.firstIndex + indexIt];
+		Float3 p0 = getPosition(triangle[0]);
+		Float3 normal = cross(getPosition(triangle[1]) - p0, getPosition(triangle[2]) - p0);
+		float normalLength = length(normal);
+
+		if (normalLength > 0.0f)
+			minDot = std::min(minDot, dot(normal, axis) / normalLength);
+	}
+
+	meshlet.center[0] = center.x;
+	meshlet.center[1] = center.y;
+	meshlet.center[2] = center.z;
+	meshlet.radius = radius;
+	meshlet.coneAxis[0] = axis.x;
+	meshlet.coneAxis[1] = axis.y;
+	meshlet.coneAxis[2] = axis.z;
+	meshlet.coneCutoff = minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+}
+
+}
+
+void buildMeshlets(
+	const uint32_t* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount,
+	std::vector<Meshlet>& outMeshlets)
+{
+	assert(indexCount % 3 == 0);
+
+	outMeshlets.clear();
+	outMeshlets.reserve(indexCount / (3 * Meshlet::MaxTriangleCount) + 1);
+
+	std::vector<uint32_t> vertexMeshlet(vertexCount, ~0u); // last meshlet that used the vertex
+	std::vector<uint32_t> meshletVertices;
+	meshletVertices.reserve(Meshlet::MaxVertexCount);
+
+	Meshlet meshlet = {};
+
+	auto flushMeshlet = [&]()
+	{
+		if (meshlet.indexCount == 0)
+			return;
+
+		computeMeshletBounds(indices, positions, positionStride, meshletVertices, meshlet);
+		outMeshlets.push_back(meshlet);
+
+		meshlet = {};
+		meshlet.firstIndex = static_cast<uint32_t>(outMeshlets.back().firstIndex + outMeshlets.back().indexCount);
+		meshletVertices.clear();
+	};
+
+	for (size_t indexIt = 0; indexIt < indexCount; indexIt += 3)
+	{
+		uint32_t meshletIndex = static_cast<uint32_t>(outMeshlets.size());
+		uint32_t newVertexCount = 0;
+		for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+			newVertexCount += vertexMeshlet[indices[indexIt + cornerIt]] != meshletIndex;
+
+		if (meshletVertices.size() + newVertexCount > Meshlet::MaxVertexCount ||
+			meshlet.indexCount / 3 + 1 > Meshlet::MaxTriangleCount)
+		{
+			flushMeshlet();
+			meshletIndex = static_cast<uint32_t>(outMeshlets.size());
+		}
+
+		for (uint32_t cornerIt = 0; cornerIt < 3; cornerIt++)
+		{
+			uint32_t vertex = indices[indexIt + cornerIt];
+			if (vertexMeshlet[vertex] != meshletIndex)
+			{
+				vertexMeshlet[vertex] = meshletIndex;
+				meshletVertices.push_back(vertex);
+			}
+		}
+
+		meshlet.indexCount += 3;
+	}
+
+	flushMeshlet();
+}
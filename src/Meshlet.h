@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Cluster of at most MaxVertexCount vertices and MaxTriangleCount triangles, stored as a
+// range of the mesh's index buffer. Bounds are in object space.
+struct Meshlet
+{
+	static constexpr uint32_t MaxVertexCount = 64;
+	static constexpr uint32_t MaxTriangleCount = 124;
+
+	float center[3]; // bounding sphere
+	float radius;
+	float coneAxis[3]; // average (outward) triangle normal
+	float coneCutoff; // sine of the normal cone half angle, 1 if the normals spread too much to ever cull
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+static_assert(sizeof(Meshlet) == 40);
+
+// Splits the triangle list into meshlets of consecutive triangles, so the index buffer itself is
+// unchanged. Run it after optimizeVertexCache, which keeps neighbouring triangles together.
+void buildMeshlets(
+	const uint32_t* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount,
+	std::vector<Meshlet>& outMeshlets);
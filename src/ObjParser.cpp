@@ -0,0 +1,391 @@
+#include "ObjParser.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+struct ObjCorner
+{
+	ObjIndex index;
+	uint8_t relativeMask = 0; // bit n set if component n was a negative (relative) index
+};
+
+struct ObjChunk
+{
+	std::vector<float> positions;
+	std::vector<float> normals;
+	std::vector<float> texcoords;
+	std::vector<ObjIndex> indices;
+
+	// relative indices are resolved against the chunk's own element counts while parsing and get
+	// the element counts of all earlier chunks added when merging. entry = indexIt * 3 + component
+	std::vector<uint32_t> relativeFixups;
+
+	bool error = false;
+};
+
+inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+	return static_cast<unsigned>(c - '0') < 10;
+}
+
+inline const char* skipSpace(const char* it, const char* end)
+{
+	while (it < end && isSpace(*it))
+		++it;
+
+	return it;
+}
+
+// not correctly rounded in all cases, but well within float precision for the range used in meshes
+const char* parseFloat(const char* it, const char* end, float& out)
+{
+	static constexpr double powersOf10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	it = skipSpace(it, end);
+
+	bool negative = false;
+	if (it < end && (*it == '-' || *it == '+'))
+		negative = (*it++ == '-');
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digitCount = 0;
+	const char* digitsBegin = it;
+
+	for (; it < end && isDigit(*it); ++it, ++digitCount)
+	{
+		if (digitCount < 19)
+			mantissa = mantissa * 10 + (*it - '0');
+		else
+			exponent++;
+	}
+
+	if (it < end && *it == '.')
+	{
+		for (++it; it < end && isDigit(*it); ++it, ++digitCount)
+		{
+			if (digitCount < 19)
+			{
+				mantissa = mantissa * 10 + (*it - '0');
+				exponent--;
+			}
+		}
+	}
+
+	if (it == digitsBegin)
+		return nullptr;
+
+	if (it < end && (*it == 'e' || *it == 'E'))
+	{
+		const char* exponentIt = it + 1;
+		bool negativeExponent = false;
+		if (exponentIt < end && (*exponentIt == '-' || *exponentIt == '+'))
+			negativeExponent = (*exponentIt++ == '-');
+
+		if (exponentIt < end && isDigit(*exponentIt))
+		{
+			int exponentValue = 0;
+			for (; exponentIt < end && isDigit(*exponentIt); ++exponentIt)
+				exponentValue = std::min(exponentValue * 10 + (*exponentIt - '0'), 9999);
+
+			exponent += negativeExponent ? -exponentValue : exponentValue;
+			it = exponentIt;
+		}
+	}
+
+	double value = static_cast<double>(mantissa);
+	if (exponent < 0 && exponent >= -22)
+		value /= powersOf10[-exponent];
+	else if (exponent > 0 && exponent <= 22)
+		value *= powersOf10[exponent];
+	else if (exponent != 0)
+		value *= std::pow(10.0, exponent);
+
+	out = static_cast<float>(negative ? -value : value);
+
+	return it;
+}
+
+inline const char* parseInt(const char* it, const char* end, int32_t& out)
+{
+	bool negative = false;
+	if (it < end && (*it == '-' || *it == '+'))
+		negative = (*it++ == '-');
+
+	if (it == end || !isDigit(*it))
+		return nullptr;
+
+	int64_t value = 0;
+	for (; it < end && isDigit(*it); ++it)
+		value = std::min<int64_t>(value * 10 + (*it - '0'), INT32_MAX);
+
+	out = static_cast<int32_t>(negative ? -value : value);
+
+	return it;
+}
+
+const char* parseFloats(const char* it, const char* end, std::vector<float>& out, uint32_t count, uint32_t requiredCount)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float value = 0.0f;
+		const char* next = parseFloat(it, end, value);
+		if (!next)
+		{
+			if (i < requiredCount)
+				return nullptr;
+
+			next = it;
+		}
+
+		out.push_back(value);
+		it = next;
+	}
+
+	return it;
+}
+
+// resolves a one based (or negative, relative) obj index against the chunk local element count
+inline bool resolveIndex(int32_t value, size_t localCount, int32_t& outIndex, uint8_t& outRelativeMask, uint8_t component)
+{
+	if (value > 0)
+	{
+		outIndex = value - 1;
+	}
+	else if (value < 0)
+	{
+		outIndex = static_cast<int32_t>(localCount) + value;
+		outRelativeMask |= (1 << component);
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool parseFace(const char* it, const char* end, ObjChunk& chunk, std::vector<ObjCorner>& corners)
+{
+	corners.clear();
+
+	size_t positionCount = chunk.positions.size() / 3;
+	size_t texcoordCount = chunk.texcoords.size() / 2;
+	size_t normalCount = chunk.normals.size() / 3;
+
+	// a trailing comment ends the corner list, like the unparsed tail of any other line
+	for (it = skipSpace(it, end); it < end && *it != '#'; it = skipSpace(it, end))
+	{
+		ObjCorner corner;
+		int32_t value;
+
+		if (!(it = parseInt(it, end, value)) ||
+			!resolveIndex(value, positionCount, corner.index.position, corner.relativeMask, 0))
+			return false;
+
+		if (it < end && *it == '/')
+		{
+			++it;
+			if (it < end && *it != '/')
+			{
+				if (!(it = parseInt(it, end, value)) ||
+					!resolveIndex(value, texcoordCount, corner.index.texcoord, corner.relativeMask, 1))
+					return false;
+			}
+
+			if (it < end && *it == '/')
+			{
+				++it;
+				if (!(it = parseInt(it, end, value)) ||
+					!resolveIndex(value, normalCount, corner.index.normal, corner.relativeMask, 2))
+					return false;
+			}
+		}
+
+		if (it < end && !isSpace(*it) && *it != '#')
+			return false;
+
+		corners.push_back(corner);
+	}
+
+	if (corners.size() < 3)
+		return false;
+
+	// triangle fan
+	auto emitCorner = [&chunk](const ObjCorner& corner)
+	{
+		uint32_t indexIt = static_cast<uint32_t>(chunk.indices.size());
+		for (uint32_t component = 0; component < 3; component++)
+			if (corner.relativeMask & (1 << component))
+				chunk.relativeFixups.push_back(indexIt * 3 + component);
+
+		chunk.indices.push_back(corner.index);
+	};
+
+	for (size_t cornerIt = 1; cornerIt + 1 < corners.size(); cornerIt++)
+	{
+		emitCorner(corners[0]);
+		emitCorner(corners[cornerIt]);
+		emitCorner(corners[cornerIt + 1]);
+	}
+
+	return true;
+}
+
+void parseChunk(const char* begin, const char* end, ObjChunk& chunk)
+{
+	std::vector<ObjCorner> corners;
+
+	for (const char* it = begin; it < end && !chunk.error;)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(it, '\n', end - it));
+		if (!lineEnd)
+			lineEnd = end;
+
+		const char* line = skipSpace(it, lineEnd);
+		size_t lineLength = lineEnd - line;
+
+		if (lineLength >= 2 && line[0] == 'v' && isSpace(line[1]))
+			chunk.error = !parseFloats(line + 2, lineEnd, chunk.positions, 3, 3);
+		else if (lineLength >= 3 && line[0] == 'v' && line[1] == 't' && isSpace(line[2]))
+			chunk.error = !parseFloats(line + 3, lineEnd, chunk.texcoords, 2, 1);
+		else if (lineLength >= 3 && line[0] == 'v' && line[1] == 'n' && isSpace(line[2]))
+			chunk.error = !parseFloats(line + 3, lineEnd, chunk.normals, 3, 3);
+		else if (lineLength >= 2 && line[0] == 'f' && isSpace(line[1]))
+			chunk.error = !parseFace(line + 2, lineEnd, chunk, corners);
+
+		it = lineEnd + 1;
+	}
+}
+
+}
+
+void loadObj(const std::filesystem::path& path, JobSystem& jobSystem, ObjMesh& outMesh)
+{
+	MappedFile file(path);
+
+	parseObj(file.data(), file.size(), jobSystem, outMesh);
+}
+
+void parseObj(const char* data, size_t size, JobSystem& jobSystem, ObjMesh& outMesh)
+{
+	constexpr size_t minChunkSize = 1 << 20;
+	constexpr uint32_t chunksPerThread = 4; // a few chunks per thread evens out uneven line mixes
+
+	uint32_t threadCount = jobSystem.getThreadCount() + 1; // the calling thread helps out
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / minChunkSize, threadCount * chunksPerThread));
+
+	// split on line boundaries
+	std::vector<const char*> chunkBegins(chunkCount + 1);
+	chunkBegins[0] = data;
+	chunkBegins[chunkCount] = data + size;
+	for (size_t chunkIt = 1; chunkIt < chunkCount; chunkIt++)
+	{
+		const char* it = std::max(data + (size * chunkIt) / chunkCount, chunkBegins[chunkIt - 1]);
+		const char* lineEnd = static_cast<const char*>(memchr(it, '\n', (data + size) - it));
+		chunkBegins[chunkIt] = lineEnd ? lineEnd + 1 : data + size;
+	}
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	jobSystem.parallelFor(static_cast<uint32_t>(chunkCount), [&chunks, &chunkBegins](uint32_t chunkIt)
+	{
+		parseChunk(chunkBegins[chunkIt], chunkBegins[chunkIt + 1], chunks[chunkIt]);
+	});
+
+	struct ChunkOffsets
+	{
+		size_t positions = 0;
+		size_t normals = 0;
+		size_t texcoords = 0;
+		size_t indices = 0;
+	};
+
+	std::vector<ChunkOffsets> chunkOffsets(chunkCount + 1);
+	for (size_t chunkIt = 0; chunkIt < chunkCount; chunkIt++)
+	{
+		const ObjChunk& chunk = chunks[chunkIt];
+		if (chunk.error)
+			throw std::runtime_error("Failed to parse model.");
+
+		chunkOffsets[chunkIt + 1].positions = chunkOffsets[chunkIt].positions + chunk.positions.size();
+		chunkOffsets[chunkIt + 1].normals = chunkOffsets[chunkIt].normals + chunk.normals.size();
+		chunkOffsets[chunkIt + 1].texcoords = chunkOffsets[chunkIt].texcoords + chunk.texcoords.size();
+		chunkOffsets[chunkIt + 1].indices = chunkOffsets[chunkIt].indices + chunk.indices.size();
+	}
+
+	const ChunkOffsets& totals = chunkOffsets[chunkCount];
+	if (totals.positions / 3 > static_cast<size_t>(INT32_MAX) || totals.indices > static_cast<size_t>(UINT32_MAX))
+		throw std::runtime_error("Model is too large.");
+
+	outMesh.positions.resize(totals.positions);
+	outMesh.normals.resize(totals.normals);
+	outMesh.texcoords.resize(totals.texcoords);
+	outMesh.indices.resize(totals.indices);
+
+	std::atomic<bool> invalidIndex = false;
+
+	// merge, resolving relative indices and validating all of them against the final element counts
+	jobSystem.parallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t chunkIt)
+	{
+		ObjChunk& chunk = chunks[chunkIt];
+		const ChunkOffsets& offsets = chunkOffsets[chunkIt];
+
+		std::copy(chunk.positions.begin(), chunk.positions.end(), outMesh.positions.begin() + offsets.positions);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), outMesh.normals.begin() + offsets.normals);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), outMesh.texcoords.begin() + offsets.texcoords);
+
+		const std::array<int32_t, 3> bases =
+		{
+			static_cast<int32_t>(offsets.positions / 3),
+			static_cast<int32_t>(offsets.texcoords / 2),
+			static_cast<int32_t>(offsets.normals / 3)
+		};
+
+		for (uint32_t fixup : chunk.relativeFixups)
+		{
+			ObjIndex& index = chunk.indices[fixup / 3];
+			int32_t* components[] = { &index.position, &index.texcoord, &index.normal };
+			*components[fixup % 3] += bases[fixup % 3];
+		}
+
+		const int32_t positionCount = static_cast<int32_t>(totals.positions / 3);
+		const int32_t texcoordCount = static_cast<int32_t>(totals.texcoords / 2);
+		const int32_t normalCount = static_cast<int32_t>(totals.normals / 3);
+
+		for (const ObjIndex& index : chunk.indices)
+		{
+			if (index.position < 0 || index.position >= positionCount ||
+				index.texcoord < -1 || index.texcoord >= texcoordCount ||
+				index.normal < -1 || index.normal >= normalCount)
+			{
+				invalidIndex = true;
+				break;
+			}
+		}
+
+		std::copy(chunk.indices.begin(), chunk.indices.end(), outMesh.indices.begin() + offsets.indices);
+
+		chunk = ObjChunk();
+	});
+
+	if (invalidIndex)
+		throw std::runtime_error("Invalid index in model.");
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+class JobSystem;
+
+struct ObjIndex
+{
+	int32_t position = -1; // zero based, -1 if missing
+	int32_t texcoord = -1;
+	int32_t normal = -1;
+};
+
+struct ObjMesh
+{
+	std::vector<float> positions; // xyz
+	std::vector<float> normals; // xyz
+	std::vector<float> texcoords; // uv
+	std::vector<ObjIndex> indices; // polygons are triangulated, three indices per triangle
+};
+
+// Parses vertices, texcoords, normals and faces of a Wavefront OBJ file. The file is memory mapped,
+// split on line boundaries and the chunks are parsed and merged in parallel on jobSystem.
+// Everything else (groups, materials, smoothing) is ignored. Throws std::runtime_error on failure.
+void loadObj(const std::filesystem::path& path, JobSystem& jobSystem, ObjMesh& outMesh);
+
+void parseObj(const char* data, size_t size, JobSystem& jobSystem, ObjMesh& outMesh);
@@ -0,0 +1,43 @@
+#include "RingAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+RingAllocator::RingAllocator(uint64_t capacity, uint32_t frameCount)
+	: myCapacity(capacity)
+	, myFrameEnds(frameCount, 0)
+{
+	assert(capacity > 0);
+}
+
+uint64_t RingAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+	assert(alignment > 0 && myCapacity % alignment == 0);
+
+	uint64_t begin = (myHead + alignment - 1) / alignment * alignment;
+
+	// allocations don't wrap, skip the rest of the ring instead
+	if (begin % myCapacity + size > myCapacity)
+		begin = (begin / myCapacity + 1) * myCapacity;
+
+	if (size > myCapacity || begin + size - myTail > myCapacity)
+	{
+		myFailedAllocationCount++;
+		return InvalidOffset;
+	}
+
+	myHead = begin + size;
+	myHighWaterMark = std::max(myHighWaterMark, myHead - myTail);
+
+	return begin % myCapacity;
+}
+
+void RingAllocator::endFrame(uint32_t frameIndex)
+{
+	myFrameEnds[frameIndex] = myHead;
+}
+
+void RingAllocator::releaseFrame(uint32_t frameIndex)
+{
+	myTail = std::max(myTail, myFrameEnds[frameIndex]);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Sub-allocates a fixed size ring, such as a persistently mapped staging buffer, for memory that
+// the gpu reads once. Allocations made while recording a frame are tagged with that frame's slot
+// by endFrame(), and given back by releaseFrame() once the slot's fence has been waited.
+//
+// Positions only ever grow, so slots may retire in any order: waiting on a fence also retires
+// everything submitted before it, so the tail simply moves to the latest end released so far.
+class RingAllocator
+{
+public:
+
+	static constexpr uint64_t InvalidOffset = ~0ull;
+
+	// alignment of every allocation must divide capacity
+	RingAllocator(uint64_t capacity, uint32_t frameCount);
+
+	// Returns the offset into the ring, or InvalidOffset if size doesn't fit in the free space.
+	uint64_t allocate(uint64_t size, uint64_t alignment);
+
+	// everything allocated since the last call is used by the frame submitted in frameIndex
+	void endFrame(uint32_t frameIndex);
+	// the frame submitted in frameIndex is done on the gpu
+	void releaseFrame(uint32_t frameIndex);
+
+	inline uint64_t getCapacity() const { return myCapacity; }
+	inline uint64_t getUsedSize() const { return myHead - myTail; }
+	inline uint64_t getHighWaterMark() const { return myHighWaterMark; }
+	inline uint64_t getFailedAllocationCount() const { return myFailedAllocationCount; }
+
+private:
+
+	uint64_t myCapacity = 0;
+	uint64_t myHead = 0; // position of the next allocation, the ring offset is myHead % myCapacity
+	uint64_t myTail = 0; // position of the oldest allocation still in use
+	uint64_t myHighWaterMark = 0;
+	uint64_t myFailedAllocationCount = 0;
+	std::vector<uint64_t> myFrameEnds; // count = [frameCount], head when the frame was submitted
+};
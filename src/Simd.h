@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#	define SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#	include <emmintrin.h>
+#	define SIMD_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#	define SIMD_NEON 1
+#endif
+
+// Width lanes of float, AVX2, SSE2 or NEON depending on the target, and a single float otherwise.
+// Only has what the transform kernels need. Converts implicitly from float, so the templates in
+// Math.h (lerp, ramp, smoothstep, ...) work on lanes as they are, clamp has an overload below.
+struct SimdFloat
+{
+#if defined(SIMD_AVX2)
+	static constexpr uint32_t Width = 8;
+	__m256 v;
+
+	SimdFloat() = default;
+	SimdFloat(__m256 x) : v(x) {}
+	SimdFloat(float x) : v(_mm256_set1_ps(x)) {}
+
+	static inline SimdFloat load(const float* p) { return _mm256_loadu_ps(p); }
+	inline void store(float* p) const { _mm256_storeu_ps(p, v); }
+#elif defined(SIMD_SSE2)
+	static constexpr uint32_t Width = 4;
+	__m128 v;
+
+	SimdFloat() = default;
+	SimdFloat(__m128 x) : v(x) {}
+	SimdFloat(float x) : v(_mm_set1_ps(x)) {}
+
+	static inline SimdFloat load(const float* p) { return _mm_loadu_ps(p); }
+	inline void store(float* p) const { _mm_storeu_ps(p, v); }
+#elif defined(SIMD_NEON)
+	static constexpr uint32_t Width = 4;
+	float32x4_t v;
+
+	SimdFloat() = default;
+	SimdFloat(float32x4_t x) : v(x) {}
+	SimdFloat(float x) : v(vdupq_n_f32(x)) {}
+
+	static inline SimdFloat load(const float* p) { return vld1q_f32(p); }
+	inline void store(float* p) const { vst1q_f32(p, v); }
+#else
+	static constexpr uint32_t Width = 1;
+	float v;
+
+	SimdFloat() = default;
+	SimdFloat(float x) : v(x) {}
+
+	static inline SimdFloat load(const float* p) { return *p; }
+	inline void store(float* p) const { *p = v; }
+#endif
+};
+
+#if defined(SIMD_AVX2)
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline SimdFloat abs(SimdFloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline SimdFloat floor(SimdFloat a) { return _mm256_floor_ps(a.v); }
+inline SimdFloat min(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+inline SimdFloat max(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+inline SimdFloat copySign(SimdFloat magnitude, SimdFloat sign)
+{
+	__m256 signMask = _mm256_set1_ps(-0.0f);
+	return _mm256_or_ps(_mm256_andnot_ps(signMask, magnitude.v), _mm256_and_ps(signMask, sign.v));
+}
+
+#elif defined(SIMD_SSE2)
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return _mm_add_ps(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a.v, b.v); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a.v, b.v); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return _mm_div_ps(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline SimdFloat abs(SimdFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline SimdFloat floor(SimdFloat a)
+{
+	// no round instruction before sse4.1: truncate, then step down where that rounded up. |a| < 2^31
+	__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+	return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a.v), _mm_set1_ps(1.0f)));
+}
+inline SimdFloat min(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+inline SimdFloat max(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+inline SimdFloat copySign(SimdFloat magnitude, SimdFloat sign)
+{
+	__m128 signMask = _mm_set1_ps(-0.0f);
+	return _mm_or_ps(_mm_andnot_ps(signMask, magnitude.v), _mm_and_ps(signMask, sign.v));
+}
+
+#elif defined(SIMD_NEON)
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return vaddq_f32(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return vsubq_f32(a.v, b.v); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return vmulq_f32(a.v, b.v); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return vdivq_f32(a.v, b.v); }
+inline SimdFloat operator-(SimdFloat a) { return vnegq_f32(a.v); }
+inline SimdFloat abs(SimdFloat a) { return vabsq_f32(a.v); }
+inline SimdFloat floor(SimdFloat a) { return vrndmq_f32(a.v); }
+inline SimdFloat min(SimdFloat a, SimdFloat b) { return vminq_f32(a.v, b.v); }
+inline SimdFloat max(SimdFloat a, SimdFloat b) { return vmaxq_f32(a.v, b.v); }
+inline SimdFloat copySign(SimdFloat magnitude, SimdFloat sign)
+{
+	return vbslq_f32(vdupq_n_u32(0x80000000u), sign.v, magnitude.v);
+}
+
+#else
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return a.v + b.v; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return a.v - b.v; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return a.v * b.v; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return a.v / b.v; }
+inline SimdFloat operator-(SimdFloat a) { return -a.v; }
+inline SimdFloat abs(SimdFloat a) { return std::abs(a.v); }
+inline SimdFloat floor(SimdFloat a) { return std::floor(a.v); }
+inline SimdFloat min(SimdFloat a, SimdFloat b) { return a.v < b.v ? a.v : b.v; }
+inline SimdFloat max(SimdFloat a, SimdFloat b) { return a.v > b.v ? a.v : b.v; }
+inline SimdFloat copySign(SimdFloat magnitude, SimdFloat sign) { return std::copysign(magnitude.v, sign.v); }
+
+#endif
+
+// rows[i] = lane i of every rows[j], turns Width values of each lane into one SimdFloat per lane
+inline void transpose(SimdFloat (&rows)[SimdFloat::Width])
+{
+#if defined(SIMD_AVX2)
+	__m256 t0 = _mm256_unpacklo_ps(rows[0].v, rows[1].v);
+	__m256 t1 = _mm256_unpackhi_ps(rows[0].v, rows[1].v);
+	__m256 t2 = _mm256_unpacklo_ps(rows[2].v, rows[3].v);
+	__m256 t3 = _mm256_unpackhi_ps(rows[2].v, rows[3].v);
+	__m256 t4 = _mm256_unpacklo_ps(rows[4].v, rows[5].v);
+	__m256 t5 = _mm256_unpackhi_ps(rows[4].v, rows[5].v);
+	__m256 t6 = _mm256_unpacklo_ps(rows[6].v, rows[7].v);
+	__m256 t7 = _mm256_unpackhi_ps(rows[6].v, rows[7].v);
+	__m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	rows[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+	rows[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+	rows[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+	rows[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+	rows[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+	rows[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+	rows[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+	rows[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+#elif defined(SIMD_SSE2)
+	_MM_TRANSPOSE4_PS(rows[0].v, rows[1].v, rows[2].v, rows[3].v);
+#elif defined(SIMD_NEON)
+	float32x4x2_t t01 = vtrnq_f32(rows[0].v, rows[1].v);
+	float32x4x2_t t23 = vtrnq_f32(rows[2].v, rows[3].v);
+	rows[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+	rows[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+	rows[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+	rows[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+#else
+	(void)rows;
+#endif
+}
+
+// the generic clamp in Math.h branches, which lanes can't
+template <typename U, typename V>
+inline SimdFloat clamp(SimdFloat x, U lowerlimit, V upperlimit)
+{
+	return min(max(x, static_cast<float>(lowerlimit)), static_cast<float>(upperlimit));
+}
+
+// sin(2 * pi * turns), within 1e-7 of std::sin
+inline SimdFloat sinTurns(SimdFloat turns)
+{
+	// reduce to [-0.5, 0.5] turns, then mirror into [-0.25, 0.25] around the peaks
+	SimdFloat x = turns - floor(turns + 0.5f);
+	x = copySign(0.25f - abs(0.25f - abs(x)), x);
+
+	// taylor series of sin around 0 up to x^11, the error is largest at pi / 2
+	constexpr float twoPi = 6.28318530717958647692f;
+	SimdFloat z = x * twoPi;
+	SimdFloat z2 = z * z;
+
+	return z * (1.0f + z2 * (-1.0f / 6.0f + z2 * (1.0f / 120.0f + z2 * (-1.0f / 5040.0f + z2 *
+		(1.0f / 362880.0f + z2 * (-1.0f / 39916800.0f))))));
+}
+
+inline SimdFloat cosTurns(SimdFloat turns)
+{
+	return sinTurns(turns + 0.25f);
+}
@@ -0,0 +1,73 @@
+#include "TaskGraph.h"
+
+#include <cassert>
+
+TaskGraph::TaskHandle TaskGraph::add(Task&& task, std::initializer_list<TaskHandle> dependencies)
+{
+	return add(std::move(task), dependencies.begin(), static_cast<uint32_t>(dependencies.size()));
+}
+
+TaskGraph::TaskHandle TaskGraph::add(Task&& task, const std::vector<TaskHandle>& dependencies)
+{
+	return add(std::move(task), dependencies.data(), static_cast<uint32_t>(dependencies.size()));
+}
+
+TaskGraph::TaskHandle TaskGraph::add(Task&& task, const TaskHandle* dependencies, uint32_t dependencyCount)
+{
+	TaskHandle handle = myTaskCount++;
+	if (handle == myNodes.size())
+		myNodes.emplace_back(std::make_unique<Node>());
+
+	Node& node = *myNodes[handle];
+	node.task = std::move(task);
+	node.dependencyCount = dependencyCount;
+
+	for (uint32_t dependencyIt = 0; dependencyIt < dependencyCount; dependencyIt++)
+	{
+		assert(dependencies[dependencyIt] < handle);
+		myNodes[dependencies[dependencyIt]]->successors.push_back(handle);
+	}
+
+	return handle;
+}
+
+void TaskGraph::run(JobSystem& jobSystem)
+{
+	myPendingTaskCount.store(myTaskCount, std::memory_order_relaxed);
+
+	for (uint32_t taskIt = 0; taskIt < myTaskCount; taskIt++)
+		myNodes[taskIt]->pendingDependencyCount.store(myNodes[taskIt]->dependencyCount, std::memory_order_relaxed);
+
+	for (uint32_t taskIt = 0; taskIt < myTaskCount; taskIt++)
+		if (myNodes[taskIt]->dependencyCount == 0)
+			submit(jobSystem, taskIt);
+
+	jobSystem.wait(myPendingTaskCount);
+}
+
+void TaskGraph::clear()
+{
+	for (uint32_t taskIt = 0; taskIt < myTaskCount; taskIt++)
+	{
+		myNodes[taskIt]->task = nullptr;
+		myNodes[taskIt]->successors.clear();
+	}
+
+	myTaskCount = 0;
+}
+
+void TaskGraph::submit(JobSystem& jobSystem, TaskHandle handle)
+{
+	jobSystem.submit([this, &jobSystem, handle]
+	{
+		Node& node = *myNodes[handle];
+		node.task();
+
+		// the last dependency to finish submits the successor, and the release makes this task's writes visible to it
+		for (TaskHandle successor : node.successors)
+			if (myNodes[successor]->pendingDependencyCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				submit(jobSystem, successor);
+
+		myPendingTaskCount.fetch_sub(1, std::memory_order_release);
+	});
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+// Tasks with explicit dependencies, run on a JobSystem. Every task is submitted as soon as the
+// last of its dependencies has finished, so independent chains overlap and running the graph
+// takes as long as its longest path instead of the sum of all tasks.
+// Tasks may use the job system themselves, e.g. parallelFor.
+class TaskGraph
+{
+public:
+
+	using Task = std::function<void()>;
+	using TaskHandle = uint32_t;
+
+	// dependencies must have been added before the task
+	TaskHandle add(Task&& task, std::initializer_list<TaskHandle> dependencies = {});
+	TaskHandle add(Task&& task, const std::vector<TaskHandle>& dependencies);
+
+	// runs every task once and returns when all of them have finished, the calling thread helps out
+	void run(JobSystem& jobSystem);
+
+	// removes all tasks, keeps the memory for the next graph
+	void clear();
+
+	inline uint32_t getTaskCount() const { return myTaskCount; }
+
+private:
+
+	struct Node
+	{
+		Task task;
+		std::vector<TaskHandle> successors;
+		uint32_t dependencyCount = 0;
+		std::atomic<uint32_t> pendingDependencyCount = 0;
+	};
+
+	TaskHandle add(Task&& task, const TaskHandle* dependencies, uint32_t dependencyCount);
+	void submit(JobSystem& jobSystem, TaskHandle handle);
+
+	std::vector<std::unique_ptr<Node>> myNodes; // count = [capacity], the first myTaskCount are in use
+	uint32_t myTaskCount = 0;
+	std::atomic<uint32_t> myPendingTaskCount = 0;
+};
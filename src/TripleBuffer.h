@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Single producer, single consumer mailbox of the latest value. The producer fills the back slot
+// and publishes it, the consumer takes whatever was published last. There is always a third slot
+// to swap with, so neither side ever writes or reads a slot the other one is using.
+// Waiting is only needed for pacing, and every wait returns early once the mailbox is closed.
+template <typename T>
+class TripleBuffer
+{
+public:
+
+	// producer side, the slot to fill before the next publish()
+	inline T& getBack() { return mySlots[myBackIndex]; }
+
+	// hands the back slot to the consumer, replacing a published value that was never taken
+	void publish()
+	{
+		uint32_t previous = myReadyState.exchange(myBackIndex | FreshBit, std::memory_order_acq_rel);
+		myBackIndex = previous & IndexMask;
+
+		notify();
+	}
+
+	// producer side, waits until the consumer has taken the last published value.
+	// returns false if the mailbox was closed.
+	bool waitUntilTaken()
+	{
+		std::unique_lock<std::mutex> lock(myMutex);
+		myCondition.wait(lock, [this]
+		{
+			return !(myReadyState.load(std::memory_order_acquire) & FreshBit) || myClosedFlag;
+		});
+
+		return !myClosedFlag;
+	}
+
+	// consumer side, takes the latest published value. waits for one if nothing was published since
+	// the last call, and returns null if the mailbox was closed meanwhile.
+	const T* acquire()
+	{
+		{
+			std::unique_lock<std::mutex> lock(myMutex);
+			myCondition.wait(lock, [this]
+			{
+				return (myReadyState.load(std::memory_order_acquire) & FreshBit) || myClosedFlag;
+			});
+
+			if (myClosedFlag)
+				return nullptr;
+		}
+
+		uint32_t previous = myReadyState.exchange(myFrontIndex, std::memory_order_acq_rel);
+		myFrontIndex = previous & IndexMask;
+
+		notify();
+
+		return &mySlots[myFrontIndex];
+	}
+
+	// wakes up and fails all waits, now and later
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(myMutex);
+			myClosedFlag = true;
+		}
+		myCondition.notify_all();
+	}
+
+private:
+
+	enum : uint32_t
+	{
+		IndexMask = 0x3,
+		FreshBit = 0x4, // set while the ready slot holds a value the consumer hasn't taken
+	};
+
+	void notify()
+	{
+		// the lock orders the state change against a waiter checking its predicate
+		{
+			std::lock_guard<std::mutex> lock(myMutex);
+		}
+		myCondition.notify_all();
+	}
+
+	std::array<T, 3> mySlots;
+	uint32_t myBackIndex = 0; // only touched by the producer
+	uint32_t myFrontIndex = 1; // only touched by the consumer
+	std::atomic<uint32_t> myReadyState = 2; // index of the ready slot | FreshBit
+
+	std::mutex myMutex;
+	std::condition_variable myCondition;
+	bool myClosedFlag = false;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <volk.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Four 16-bit unsigned normalized components, [0, 65535] maps to [0.0, 1.0].
+struct UNorm16x4
+{
+	uint16_t x, y, z, w;
+};
+
+// Two IEEE 754 half precision floats.
+struct Half2
+{
+	uint16_t x, y;
+};
+
+// Vertex format of an attribute type, specialize for every type used in a VertexLayout.
+template <typename T>
+struct VertexAttributeFormat;
+
+template <>
+struct VertexAttributeFormat<UNorm16x4>
+{
+	static constexpr VkFormat value = VK_FORMAT_R16G16B16A16_UNORM;
+};
+
+template <>
+struct VertexAttributeFormat<Half2>
+{
+	static constexpr VkFormat value = VK_FORMAT_R16G16_SFLOAT;
+};
+
+template <uint32_t Location, typename T, uint32_t Offset>
+struct VertexAttribute
+{
+	static constexpr VkVertexInputAttributeDescription description = { Location, 0, VertexAttributeFormat<T>::value, Offset };
+};
+
+#define VERTEX_ATTRIBUTE(location, vertex, member) \
+	VertexAttribute<location, decltype(vertex::member), offsetof(vertex, member)>
+
+// Binding and attribute descriptions of VertexT, generated at compile time from its VertexAttributes.
+//
+// using MyLayout = VertexLayout<MyVertex, VERTEX_ATTRIBUTE(0, MyVertex, pos), VERTEX_ATTRIBUTE(1, MyVertex, uv)>;
+template <typename VertexT, typename... Attributes>
+struct VertexLayout
+{
+	using Vertex = VertexT;
+
+	static constexpr VkVertexInputBindingDescription bindingDescription = { 0, sizeof(VertexT), VK_VERTEX_INPUT_RATE_VERTEX };
+	static constexpr std::array<VkVertexInputAttributeDescription, sizeof...(Attributes)> attributeDescriptions = {{ Attributes::description... }};
+};
@@ -66,32 +66,38 @@ int isDeviceSuitable(VkSurfaceKHR surface, VkPhysicalDevice device, SwapChainInf
 	VkPhysicalDeviceFeatures deviceFeatures;
 	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &outSwapChainInfo.capabilities);
+	// headless: any device with a graphics queue will do, including software implementations
+	bool headless = (surface == VK_NULL_HANDLE);
 
-	uint32_t formatCount;
-	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
-	if (formatCount != 0)
+	if (!headless)
 	{
-		outSwapChainInfo.formats.resize(formatCount);
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount,
-			outSwapChainInfo.formats.data());
-	}
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &outSwapChainInfo.capabilities);
 
-	assert(!outSwapChainInfo.formats.empty());
+		uint32_t formatCount;
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+		if (formatCount != 0)
+		{
+			outSwapChainInfo.formats.resize(formatCount);
+			vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount,
+				outSwapChainInfo.formats.data());
+		}
 
-	uint32_t presentModeCount;
-	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
-	if (presentModeCount != 0)
-	{
-		outSwapChainInfo.presentModes.resize(presentModeCount);
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount,
-			outSwapChainInfo.presentModes.data());
-	}
+		assert(!outSwapChainInfo.formats.empty());
 
-	assert(!outSwapChainInfo.presentModes.empty());
+		uint32_t presentModeCount;
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+		if (presentModeCount != 0)
+		{
+			outSwapChainInfo.presentModes.resize(presentModeCount);
+			vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount,
+				outSwapChainInfo.presentModes.data());
+		}
+
+		assert(!outSwapChainInfo.presentModes.empty());
+	}
 
 	//if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU)
-	if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+	if (headless || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
 	{
 		uint32_t queueFamilyCount = 0;
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
@@ -104,8 +110,9 @@ int isDeviceSuitable(VkSurfaceKHR surface, VkPhysicalDevice device, SwapChainInf
 		{
 			const auto& queueFamily = queueFamilies[i];
 
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+			VkBool32 presentSupport = headless;
+			if (!headless)
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
 
 			if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT &&
 				presentSupport)
@@ -117,3 +124,34 @@ int isDeviceSuitable(VkSurfaceKHR surface, VkPhysicalDevice device, SwapChainInf
 
 	return -1;
 }
+
+int findTransferQueueFamily(VkPhysicalDevice device, int graphicsQueueFamilyIndex)
+{
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+		queueFamilies.data());
+
+	int bestFamily = -1;
+	for (int i = 0; i < static_cast<int>(queueFamilies.size()); i++)
+	{
+		const auto& queueFamily = queueFamilies[i];
+
+		// graphics and compute queues support transfers too, even if they don't say so
+		constexpr VkQueueFlags anyTransferFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+
+		if (i == graphicsQueueFamilyIndex || queueFamily.queueCount == 0 ||
+			!(queueFamily.queueFlags & anyTransferFlags))
+			continue;
+
+		if (!(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+			return i;
+
+		if (bestFamily < 0)
+			bestFamily = i;
+	}
+
+	return bestFamily;
+}
@@ -67,3 +67,7 @@ VkFormat findSupportedFormat(
 	VkFormatFeatureFlags features);
 
 int isDeviceSuitable(VkSurfaceKHR surface, VkPhysicalDevice device, SwapChainInfo& outSwapChainInfo);
+
+// queue family other than graphicsQueueFamilyIndex for uploads, preferring dedicated transfer
+// (dma) families. returns -1 if graphicsQueueFamilyIndex is the only family.
+int findTransferQueueFamily(VkPhysicalDevice device, int graphicsQueueFamilyIndex);
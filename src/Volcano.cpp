@@ -1,6 +1,20 @@
 #include "Volcano.h"
 #include "Core.h"
+#include "Deduplicate.h"
+#include "Hash.h"
+#include "InstanceTransforms.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
 #include "Math.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplify.h"
+#include "Meshlet.h"
+#include "ObjParser.h"
+#include "RingAllocator.h"
+#include "TaskGraph.h"
+#include "TripleBuffer.h"
+#include "VertexLayout.h"
 #include "VkUtil.h"
 
 #include <volk.h>
@@ -35,23 +49,14 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-//#define TINYOBJLOADER_USE_EXPERIMENTAL
-
-#ifdef TINYOBJLOADER_USE_EXPERIMENTAL
-#define TINYOBJ_LOADER_OPT_IMPLEMENTATION
-#include <experimental/tinyobj_loader_opt.h>
-#else
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-#endif
-
 //#define GLM_FORCE_MESSAGES
 #define GLM_LANG_STL11_FORCED
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/matrix_interpolation.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
@@ -59,25 +64,24 @@
 #include <imgui.h>
 #include <examples/imgui_impl_vulkan.h>
 
-#include <cereal/cereal.hpp>
-#include <cereal/types/vector.hpp>
-#include <cereal/archives/portable_binary.hpp>
-
 #include <algorithm>
 #include <array>
 #include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <cstdlib>
-#if defined(__WINDOWS__)
-#include <execution>
-#endif
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <stdexcept>
+#include <string>
 #include <thread>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -91,53 +95,138 @@ struct Vertex
 	{
     	return pos == other.pos && color == other.color && texCoord == other.texCoord;
 	}
+};
 
-	static VkVertexInputBindingDescription getBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription = {};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
-	}
+static_assert(sizeof(Vertex) == 8 * sizeof(float)); // no padding, vertices are hashed and compared bitwise
 
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-		return attributeDescriptions;
-	}
+// positions quantized to the mesh bounds (see Model::myDequantizeTransform), half precision texcoords, no color
+struct VertexPacked
+{
+	UNorm16x4 pos;
+	Half2 texCoord;
+};
+
+static_assert(sizeof(VertexPacked) == 12);
+
+template <>
+struct VertexAttributeFormat<glm::vec2>
+{
+	static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT;
+};
+
+template <>
+struct VertexAttributeFormat<glm::vec3>
+{
+	static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;
+};
+
+using VertexLayoutFloat = VertexLayout<Vertex,
+	VERTEX_ATTRIBUTE(0, Vertex, pos),
+	VERTEX_ATTRIBUTE(1, Vertex, color),
+	VERTEX_ATTRIBUTE(2, Vertex, texCoord)>;
 
-	template <class Archive>
-	void serialize(Archive & ar)
+using VertexLayoutPacked = VertexLayout<VertexPacked,
+	VERTEX_ATTRIBUTE(0, VertexPacked, pos),
+	VERTEX_ATTRIBUTE(2, VertexPacked, texCoord)>;
+
+// Vertex format used for uploaded meshes, together with the vertex shader variants that read it.
+struct VertexFormat
+{
+	enum
 	{
-		ar(pos.data.data, color.data.data, texCoord.data.data);
-	}
+		Float,
+		Packed,
+
+		Count
+	};
+
+	const VkVertexInputBindingDescription* bindingDescription;
+	const VkVertexInputAttributeDescription* attributeDescriptions;
+	uint32_t attributeDescriptionCount;
+	const char* vertexShaderFile;
+	const char* instancedVertexShaderFile; // also reads ourInstanceAttributeDescriptions
+	const char* pushConstantVertexShaderFile; // reads DrawPushConstants instead of the uniform buffer
+};
+
+template <typename Layout>
+constexpr VertexFormat makeVertexFormat(const char* vertexShaderFile, const char* instancedVertexShaderFile,
+	const char* pushConstantVertexShaderFile)
+{
+	return VertexFormat{
+		&Layout::bindingDescription,
+		Layout::attributeDescriptions.data(),
+		static_cast<uint32_t>(Layout::attributeDescriptions.size()),
+		vertexShaderFile,
+		instancedVertexShaderFile,
+		pushConstantVertexShaderFile };
+}
+
+static constexpr VertexFormat ourVertexFormats[VertexFormat::Count] =
+{
+	makeVertexFormat<VertexLayoutFloat>("vert.spv", "vert_instanced.spv", "vert_push.spv"),
+	makeVertexFormat<VertexLayoutPacked>("vert_packed.spv", "vert_packed_instanced.spv", "vert_packed_push.spv"),
 };
 
+// InstanceVertex, in binding 1 after the attributes of every vertex format
+static constexpr VkVertexInputBindingDescription ourInstanceBindingDescription =
+	{ 1, sizeof(InstanceVertex), VK_VERTEX_INPUT_RATE_INSTANCE };
+
+static constexpr VkVertexInputAttributeDescription ourInstanceAttributeDescriptions[] =
+{
+	{ 3, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceVertex, modelViewProj) },
+	{ 4, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceVertex, modelViewProj) + 4 * sizeof(float) },
+	{ 5, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceVertex, modelViewProj) + 8 * sizeof(float) },
+	{ 6, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceVertex, modelViewProj) + 12 * sizeof(float) },
+	{ 7, 1, VK_FORMAT_R32_UINT, offsetof(InstanceVertex, viewportIndex) },
+};
 
-namespace std
+// converts vertices to vertexFormat, positions are quantized to [boundsMin, boundsMax]
+static std::vector<char> packVertices(
+	uint32_t vertexFormat,
+	const std::vector<Vertex>& vertices,
+	const glm::vec3& boundsMin,
+	const glm::vec3& boundsMax)
 {
-    template<> struct hash<Vertex>
+	const VertexFormat& format = ourVertexFormats[vertexFormat];
+	std::vector<char> result(vertices.size() * format.bindingDescription->stride);
+
+	switch (vertexFormat)
 	{
-        size_t operator()(Vertex const& vertex) const
+	case VertexFormat::Float:
+		std::copy_n(reinterpret_cast<const char*>(vertices.data()), result.size(), result.data());
+		break;
+	case VertexFormat::Packed:
+	{
+		glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(std::numeric_limits<float>::min()));
+		VertexPacked* packedVertices = reinterpret_cast<VertexPacked*>(result.data());
+
+		for (size_t vertexIt = 0; vertexIt < vertices.size(); vertexIt++)
 		{
-            return ((hash<glm::vec3>()(vertex.pos) ^
-                   (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-                   (hash<glm::vec2>()(vertex.texCoord) << 1);
-        }
-    };
+			glm::vec3 pos = glm::round(glm::clamp((vertices[vertexIt].pos - boundsMin) / extent, 0.0f, 1.0f) * 65535.0f);
+
+			VertexPacked& packedVertex = packedVertices[vertexIt];
+			packedVertex.pos = { uint16_t(pos.x), uint16_t(pos.y), uint16_t(pos.z), 0 };
+			packedVertex.texCoord = { glm::packHalf1x16(vertices[vertexIt].texCoord.x), glm::packHalf1x16(vertices[vertexIt].texCoord.y) };
+		}
+		break;
+	}
+	default:
+		assert(false);
+		break;
+	}
+
+	return result;
+}
+
+// maps the packed position range back to object space, identity for unquantized formats
+static glm::mat4 getDequantizeTransform(uint32_t vertexFormat, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	if (vertexFormat != VertexFormat::Packed)
+		return glm::mat4(1.0f);
+
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(std::numeric_limits<float>::min()));
+
+	return glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), extent);
 }
 
 // struct Quad
@@ -151,6 +240,7 @@ struct Texture
 	VkImage myImage = VK_NULL_HANDLE;
 	VmaAllocation myImageMemory = VK_NULL_HANDLE;
 	VkImageView myImageView = VK_NULL_HANDLE;
+	uint32_t myTableIndex = 0; // slot in the bindless texture table, if the device has one
 };
 
 struct Model
@@ -160,8 +250,107 @@ struct Model
 	VkBuffer myIndexBuffer = VK_NULL_HANDLE;
 	VmaAllocation myIndexBufferMemory = VK_NULL_HANDLE;
 	uint32_t indexCount;
+	glm::mat4 myDequantizeTransform = glm::mat4(1.0f);
+	glm::vec4 myBoundingSphere = glm::vec4(0.0f); // object space center and radius
+	std::vector<Meshlet> myMeshlets;
+	std::vector<MeshLod> myLods; // full detail first
+};
+
+// cpu side result of loading a model, waiting to be uploaded
+struct ModelData
+{
+	std::unique_ptr<MeshFile> cookedFile; // vertexData and indexData point into this when loaded from the cache
+	std::vector<char> vertices;
+	std::vector<uint32_t> indices;
+	const char* vertexData = nullptr;
+	const uint32_t* indexData = nullptr;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshLod> lods;
+};
+
+// cpu side result of loading a texture, waiting to be uploaded
+struct ImageData
+{
+	std::shared_ptr<const unsigned char> pixels; // rgba8, freed by whoever allocated them
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+struct UploadQueue
+{
+	enum : uint32_t
+	{
+		Graphics, // the frame queue, for uploads that need graphics stages
+		Transfer, // separate queue and family if the device has one, otherwise the frame queue
+
+		Count
+	};
+};
+
+// copies and barriers recorded into one command buffer and submitted together, see beginUploadBatch()
+struct UploadBatch
+{
+	uint32_t queue = UploadQueue::Graphics;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers; // recorded by submitUploadBatch(), towards vertex input
+	std::vector<VkImageMemoryBarrier> imageBarriers; // recorded by submitUploadBatch(), towards fragment shader reads
+	std::vector<std::function<void()>> destroyFunctions; // run once fence has signaled
 };
 
+// frustum planes of modelViewProj in object space, normals point inwards
+static void getFrustumPlanes(const glm::mat4& modelViewProj, glm::vec4 (&outPlanes)[6])
+{
+	glm::mat4 rows = glm::transpose(modelViewProj);
+
+	outPlanes[0] = rows[3] + rows[0];
+	outPlanes[1] = rows[3] - rows[0];
+	outPlanes[2] = rows[3] + rows[1];
+	outPlanes[3] = rows[3] - rows[1];
+	outPlanes[4] = rows[2]; // zero to one depth
+	outPlanes[5] = rows[3] - rows[2];
+
+	for (auto& plane : outPlanes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+static bool isMeshletVisible(const Meshlet& meshlet, const glm::vec4 (&frustumPlanes)[6], const glm::vec3& cameraPosition)
+{
+	glm::vec3 center = glm::make_vec3(meshlet.center);
+
+	for (const auto& plane : frustumPlanes)
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -meshlet.radius)
+			return false;
+
+	// every triangle faces away from the camera
+	glm::vec3 toCenter = center - cameraPosition;
+	if (glm::dot(toCenter, glm::make_vec3(meshlet.coneAxis)) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+		return false;
+
+	return true;
+}
+
+// coarsest lod whose error projects to at most maxPixelError pixels at the nearest point of the model.
+// pixelScale is the size in pixels of one unit at distance one, half the viewport height times proj[1][1].
+static uint32_t getLod(const Model& model, const glm::vec3& cameraPosition, float pixelScale, float maxPixelError)
+{
+	float distance = glm::distance(glm::vec3(model.myBoundingSphere), cameraPosition) - model.myBoundingSphere.w;
+	if (distance <= 0.0f)
+		return 0;
+
+	float pixelsPerUnit = pixelScale / distance;
+
+	for (uint32_t lodIt = static_cast<uint32_t>(model.myLods.size()) - 1; lodIt > 0; lodIt--)
+		if (model.myLods[lodIt].error * pixelsPerUnit <= maxPixelError)
+			return lodIt;
+
+	return 0;
+}
+
 // const Vertex Quad::ourVertices[] =
 // {
 // 	{ { -1.0f, -1.0f, 0.0f },{ 1.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } },
@@ -184,29 +373,57 @@ struct Model
 class VulkanApplication
 {
 public:
-	VulkanApplication(void* view, int windowWidth, int windowHeight, int framebufferWidth, int framebufferHeight, const char* resourcePath, bool /*verbose*/)
+	VulkanApplication(void* view, int windowWidth, int windowHeight, int framebufferWidth, int framebufferHeight, const char* resourcePath, bool verbose)
 		: myResourcePath(resourcePath)
 		, myCommandBufferThreadCount(clamp(4, 2, 32))
 		, myRequestedCommandBufferThreadCount(myCommandBufferThreadCount)
+		, myHeadlessFlag(view == nullptr)
+		, myVerboseFlag(verbose)
 	{
 		assert(std::filesystem::is_directory(myResourcePath));
 
 		createInstance();
 		createDebugCallback();
 		
-		createSurface(view);
+		// headless mode renders into offscreen images, so there is no surface or swapchain
+		if (!myHeadlessFlag)
+			createSurface(view);
+
 		createDevice();
 
 		createAllocator();
 
+		createStagingRing();
+		createUploadResources();
+
 		createTextureSampler();
 
 		createDescriptorPool();
 		createDescriptorSetLayout();
+		createTextureTable();
 
 		createFrameResources(framebufferWidth, framebufferHeight);
 
-		loadModel("chalet.obj", myHouseModel);
+		myFrameDeletionQueues.resize(myFrameCount);
+
+		// placeholders are uploaded with the first frame, the real assets whenever they are ready
+		{
+			auto placeholderModel = std::make_unique<ModelData>();
+			createPlaceholderModel(*placeholderModel);
+			myLoadedModels.push_back({ &myHouseModel, std::move(placeholderModel), "placeholder" });
+
+			for (Texture* texture : { &myHouseImage, &myVulkanImage })
+			{
+				auto placeholderTexture = std::make_unique<ImageData>();
+				createPlaceholderTexture(*placeholderTexture);
+				myLoadedTextures.push_back({ texture, std::move(placeholderTexture), "placeholder" });
+			}
+		}
+
+		uint32_t loadWorkerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		myLoadJobSystem = std::make_unique<JobSystem>(loadWorkerCount);
+
+		loadModels();
 
 		// {
 		// 	createDeviceLocalBuffer(Quad::ourVertices, static_cast<uint32_t>(sizeof_array(Quad::ourVertices)),
@@ -217,28 +434,29 @@ public:
 		// 		myQuadModel.myIndexBufferMemory);
 		// }
 
-		loadTexture("chalet.jpg", myHouseImage);
-		loadTexture("2018-Vulkan-small-badge.png", myVulkanImage);
+		loadTextureAsync("chalet.jpg", myHouseImage);
+		loadTextureAsync("2018-Vulkan-small-badge.png", myVulkanImage);
 
-		// create uniform buffer
-		createBuffer(
-			NX * NY * sizeof(UniformBufferObject),
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-			myUniformBuffer,
-			myUniformBufferMemory,
-			"myUniformBuffer");
-		
-		createDescriptorSet();
+		createUniformBuffer();
+		createInstanceBuffer();
+		createCullResources();
 
-		float dpiScaleX = static_cast<float>(framebufferWidth) / windowWidth;
-		float dpiScaleY = static_cast<float>(framebufferHeight) / windowHeight;
+		if (!myHeadlessFlag)
+		{
+			float dpiScaleX = static_cast<float>(framebufferWidth) / windowWidth;
+			float dpiScaleY = static_cast<float>(framebufferHeight) / windowHeight;
 
-		initIMGUI(dpiScaleX, dpiScaleY);
+			initIMGUI(dpiScaleX, dpiScaleY);
+		}
 	}
 
 	~VulkanApplication()
 	{
+		stopSimulation();
+
+		// drops loads that haven't started, and waits for the running ones
+		myLoadJobSystem.reset();
+
 		CHECK_VK(myDeviceTable.vkDeviceWaitIdle(myDevice));
 
 		cleanup();
@@ -246,7 +464,10 @@ public:
 
 	void draw()
 	{
+		auto frameStart = std::chrono::high_resolution_clock::now();
+
 		// update input dependent state
+		if (!myHeadlessFlag)
 		{
 			ImGuiIO& io = ImGui::GetIO();
 
@@ -255,12 +476,9 @@ public:
 			if (escState && !escBufferState)
 				myUIEnableFlag = !myUIEnableFlag;
 			escBufferState = escState;
-
-			if (myCommandBufferThreadCount != myRequestedCommandBufferThreadCount)
-				myCreateFrameResourcesFlag = true;
 		}
 		
-		// re-create frame resources if needed
+		// re-create frame resources if needed, only the swapchain needs the device to be idle
 		if (myCreateFrameResourcesFlag)
 		{
 			CHECK_VK(myDeviceTable.vkDeviceWaitIdle(myDevice));
@@ -270,53 +488,252 @@ public:
 			myCommandBufferThreadCount = myRequestedCommandBufferThreadCount;
 
 			createFrameResources(myWindowData->Width, myWindowData->Height);
+
+			myCreateFrameResourcesFlag = false;
+		}
+		else if (myCommandBufferThreadCount != static_cast<uint32_t>(myRequestedCommandBufferThreadCount))
+		{
+			recreateThreadResources();
 		}
 
-		// todo: run this at the same time as secondary command buffer recording
+		// options need their pipelines, which are skipped if their shader variants weren't built
+		if (!myInstancedGraphicsPipelines.isValid())
+			myRequestedRenderOptions.instancedDraw = false;
+		if (!myPushConstantGraphicsPipelines.isValid())
+			myRequestedRenderOptions.pushConstants = false;
+		if (!myBindlessGraphicsPipelines.isValid())
+			myRequestedRenderOptions.bindlessTextures = false;
+
+		// the frame records with the options and stats as they are now, while the ui edits the requested ones
+		myRenderOptions = myRequestedRenderOptions;
+
+		if (myRenderOptions.pipelinedUpdate && !mySimulationThread.joinable())
+			startSimulation();
+		else if (!myRenderOptions.pipelinedUpdate)
+			stopSimulation();
+
+		// while this frame is recorded, the simulation works on the next one
+		myFramePacket = myFramePackets ? myFramePackets->acquire() : nullptr;
+
+		myLastFrameStats.visibleMeshletCount = myVisibleMeshletCount.exchange(0, std::memory_order_relaxed);
+		myLastFrameStats.drawnTriangleCount = myDrawnTriangleCount.exchange(0, std::memory_order_relaxed);
+		myLastFrameStats.stagingUsedSize = myStagingRing->getUsedSize();
+		myLastFrameStats.stagingHighWaterMark = myStagingRing->getHighWaterMark();
+
+		buildFrameGraph();
+		myFrameGraph.run(*myJobSystem);
+
+		presentFrame();
+
+		myFrameNumber++;
+
+		if (myHeadlessFlag)
+			myFrameTimings.push_back(std::chrono::duration<double, std::milli>(
+				std::chrono::high_resolution_clock::now() - frameStart).count());
+	}
+
+	// one frame as tasks: beginFrame, then per segment an update of its uniforms followed by its
+	// recording, so segments overlap each other and the ui. the primary is assembled when all are done.
+	void buildFrameGraph()
+	{
+		myFrameGraph.clear();
+
+		std::vector<TaskGraph::TaskHandle> primaryDependencies;
+		primaryDependencies.reserve(getSegmentCount() + 1);
+
 		if (myUIEnableFlag)
+			primaryDependencies.push_back(myFrameGraph.add([this] { buildUI(); }));
+
+		TaskGraph::TaskHandle beginTask = myFrameGraph.add([this]
 		{
-			ImGui_ImplVulkan_NewFrame();
-			ImGui::NewFrame();
+			beginFrame();
+			beginUniformUpdate();
+		});
 
-			ImGui::ShowDemoWindow();
+		constexpr uint32_t drawCount = NX * NY;
+		uint32_t segmentCount = getSegmentCount();
+		uint32_t segmentDrawCount = getSegmentDrawCount();
 
-			{
-				ImGui::Begin("Render Options");
-				ImGui::DragInt("Command Buffer Threads", &myRequestedCommandBufferThreadCount, 0.1f, 2, 32);
-				ImGui::ColorEdit3("Clear Color", &myWindowData->ClearValue.color.float32[0]);
-				ImGui::End();
-			}
+		std::vector<TaskGraph::TaskHandle> updateTasks(segmentCount);
+		for (uint32_t segmentIt = 0; segmentIt < segmentCount; segmentIt++)
+		{
+			uint32_t begin = std::min(segmentIt * segmentDrawCount, drawCount);
+			uint32_t end = std::min(begin + segmentDrawCount, drawCount);
 
+			updateTasks[segmentIt] = myFrameGraph.add([this, begin, end] { updateUniformBuffers(begin, end); }, { beginTask });
+		}
+
+		// instanced draws read the transforms of every tile
+		for (uint32_t segmentIt = 0; segmentIt < segmentCount; segmentIt++)
+		{
+			auto recordTask = [this, segmentIt] { recordSegment(segmentIt); };
+
+			primaryDependencies.push_back(myRenderOptions.instancedDraw ?
+				myFrameGraph.add(std::move(recordTask), updateTasks) :
+				myFrameGraph.add(std::move(recordTask), { updateTasks[segmentIt] }));
+		}
+
+		myFrameGraph.add([this] { submitFrame(); }, primaryDependencies);
+	}
+
+	// The simulation thread makes the frame packet of the next frame while the calling thread records
+	// the current one, and hands it over through a mailbox. It waits until its last packet was taken
+	// before it publishes the next one, so headless runs still simulate every frame.
+	void startSimulation()
+	{
+		assert(!mySimulationThread.joinable());
+
+		mySimulationInput.aspect = myWindowData->Width / static_cast<float>(myWindowData->Height);
+		mySimulationInput.dequantize = myHouseModel.myDequantizeTransform;
+
+		myFramePackets = std::make_unique<TripleBuffer<FramePacket>>();
+		mySimulationThread = std::thread([this, frameNumber = myFrameNumber]() mutable
+		{
+			for (;; frameNumber++)
 			{
-				ImGui::Begin("GUI Options");
-				static int styleIndex = 0;
-				ImGui::ShowStyleSelector("Styles", &styleIndex);
-				ImGui::ShowFontSelector("Fonts");
-				if (ImGui::Button("Show User Guide"))
-				{
-					ImGui::SetNextWindowPosCenter();
-					ImGui::OpenPopup("UserGuide");
-				}
-				if (ImGui::BeginPopup("UserGuide", ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove))
+				SimulationInput input;
 				{
-					ImGui::ShowUserGuide();
-					ImGui::EndPopup();
+					std::lock_guard<std::mutex> lock(mySimulationInputMutex);
+					input = mySimulationInput;
 				}
-				ImGui::End();
-			}
 
-			{
-				ImGui::ShowMetricsWindow();
+				FramePacket& packet = myFramePackets->getBack();
+				packet.animation = getAnimation(getAnimationTime(frameNumber), input.aspect, input.dequantize);
+
+				updateInstanceTransforms(
+					packet.animation,
+					0,
+					NX * NY,
+					packet.uniforms.data(),
+					sizeof(InstanceUniforms),
+					packet.drawTransforms.data(),
+					packet.instances.data());
+
+				if (!myFramePackets->waitUntilTaken())
+					break;
+
+				myFramePackets->publish();
 			}
+		});
+	}
+
+	void stopSimulation()
+	{
+		if (!mySimulationThread.joinable())
+			return;
+
+		myFramePackets->close();
+		mySimulationThread.join();
+		myFramePackets.reset();
+		myFramePacket = nullptr;
+	}
+
+	void runHeadless(uint32_t frameCount)
+	{
+		assert(myHeadlessFlag);
+
+		// every run measures the same frames, not however many placeholder frames the loading took
+		myLoadJobSystem->wait(myPendingLoadCount);
+
+		myFrameTimings.clear();
+		myFrameTimings.reserve(frameCount);
+
+		for (uint32_t frameIt = 0; frameIt < frameCount; frameIt++)
+			draw();
+
+		CHECK_VK(myDeviceTable.vkDeviceWaitIdle(myDevice));
+
+		if (myFrameTimings.empty())
+			return;
+
+		for (uint32_t frameIt = 0; frameIt < myFrameTimings.size(); frameIt++)
+			std::cout << "frame " << frameIt << ": " << myFrameTimings[frameIt] << " ms\n";
+
+		std::vector<double> sortedTimings(myFrameTimings);
+		std::sort(sortedTimings.begin(), sortedTimings.end());
+		double total = std::accumulate(sortedTimings.begin(), sortedTimings.end(), 0.0);
 
-			ImGui::Render();
+		std::cout << "frames: " << sortedTimings.size()
+			<< ", min: " << sortedTimings.front() << " ms"
+			<< ", median: " << sortedTimings[sortedTimings.size() / 2] << " ms"
+			<< ", avg: " << total / sortedTimings.size() << " ms"
+			<< ", max: " << sortedTimings.back() << " ms" << std::endl;
+
+		std::cout << "staging ring: " << myStagingRing->getCapacity() / 1024 << " kB"
+			<< ", peak: " << myStagingRing->getHighWaterMark() / 1024 << " kB"
+			<< ", overflows: " << myStagingRing->getFailedAllocationCount() << std::endl;
+	}
+
+	void setGpuCulling(bool enabled)
+	{
+		if (enabled && !myGpuCullingSupported)
+		{
+			std::cout << "gpu culling is not supported by the device" << std::endl;
+			return;
 		}
 
-		// todo: run this at the same time as secondary command buffer recording
-		updateUniformBuffers();
+		myRequestedRenderOptions.instancedDraw |= enabled;
+		myRequestedRenderOptions.gpuCulling = enabled;
+	}
 
-		submitFrame();
-		presentFrame();
+	void setPushConstants(bool enabled)
+	{
+		myRequestedRenderOptions.pushConstants = enabled;
+	}
+
+	void setPipelinedUpdate(bool enabled)
+	{
+		myRequestedRenderOptions.pipelinedUpdate = enabled;
+	}
+
+	void setCommandBufferCaching(bool enabled)
+	{
+		myRequestedRenderOptions.commandBufferCaching = enabled;
+	}
+
+	// the import settings are read by the loads, so they only change in between them
+	void setOptimizeModels(bool enabled)
+	{
+		if (enabled == myOptimizeModelsFlag)
+			return;
+
+		myLoadJobSystem->wait(myPendingLoadCount);
+
+		myOptimizeModelsFlag = enabled;
+
+		loadModels();
+	}
+
+	// also re-creates the pipelines, the placeholder is drawn until the models are reloaded
+	void setVertexFormat(uint32_t vertexFormat)
+	{
+		assert(vertexFormat < VertexFormat::Count);
+
+		if (vertexFormat == myVertexFormat)
+			return;
+
+		if (!hasSPIRVFile(ourVertexFormats[vertexFormat].vertexShaderFile))
+		{
+			std::cout << ourVertexFormats[vertexFormat].vertexShaderFile << " has not been built" << std::endl;
+			return;
+		}
+
+		myLoadJobSystem->wait(myPendingLoadCount);
+
+		myVertexFormat = vertexFormat;
+		myCreateFrameResourcesFlag = true;
+
+		{
+			auto placeholderModel = std::make_unique<ModelData>();
+			createPlaceholderModel(*placeholderModel);
+
+			// models that were loaded but not yet uploaded have the old format
+			std::lock_guard<std::mutex> lock(myLoadedAssetsMutex);
+			myLoadedModels.clear();
+			myLoadedModels.push_back({ &myHouseModel, std::move(placeholderModel), "placeholder" });
+		}
+
+		loadModels();
 	}
 
 	void resize(int width, int height)
@@ -330,7 +747,13 @@ public:
 
 private:
 
-	void loadModel(const char* filename, Model& outModel) const
+	// defined with the other types at the end, declared here for the member functions taking them
+	struct CullInput;
+	struct SegmentDrawList;
+	struct GraphicsPipelines;
+
+	// imports (or maps the cooked cache of) a model, only touches cpu memory so it can run on any thread
+	void loadModel(const char* filename, ModelData& outData) const
 	{
 		std::filesystem::path modelFile(myResourcePath);
 		modelFile = std::filesystem::absolute(modelFile);
@@ -338,133 +761,283 @@ private:
 		modelFile /= "models";
 		modelFile /= filename;
 		
-		std::filesystem::path modelFileCereal(modelFile);
-		modelFileCereal += ".cereal";
+		std::filesystem::path modelFileCooked(modelFile);
+		modelFileCooked += ".mesh";
 
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
-		
-		if (std::filesystem::exists(modelFileCereal) && std::filesystem::is_regular_file(modelFileCereal))
+		std::unique_ptr<MappedFile> sourceFile;
+		uint64_t sourceHash = 0;
+
+		if (std::filesystem::exists(modelFile) && std::filesystem::is_regular_file(modelFile))
+		{
+			sourceFile = std::make_unique<MappedFile>(modelFile);
+
+			// import settings change the cooked data too
+			uint64_t settings = (uint64_t(myVertexFormat) << 1) | uint64_t(myOptimizeModelsFlag);
+			sourceHash = hashData(sourceFile->data(), sourceFile->size(), settings);
+		}
+
+		// a cooked file is only used if it was cooked from the current source (or if there is no source)
+		const VertexFormat& vertexFormat = ourVertexFormats[myVertexFormat];
+
+		std::unique_ptr<MeshFile> cookedFile;
+		if (std::filesystem::exists(modelFileCooked) && std::filesystem::is_regular_file(modelFileCooked))
 		{
-			std::ifstream cerealFile(modelFileCereal.c_str(), std::ios::binary);
-			cereal::PortableBinaryInputArchive archive(cerealFile);
+			cookedFile = std::make_unique<MeshFile>(modelFileCooked);
+			if (!cookedFile->isValid() ||
+				(sourceFile && cookedFile->getHeader().sourceHash != sourceHash) ||
+				cookedFile->getBlob(MeshBlob::Vertices).elementSize != vertexFormat.bindingDescription->stride ||
+				cookedFile->getBlob(MeshBlob::Indices).elementSize != sizeof(uint32_t) ||
+				cookedFile->getBlob(MeshBlob::Meshlets).elementSize != sizeof(Meshlet) ||
+				cookedFile->getBlob(MeshBlob::Lods).elementSize != sizeof(MeshLod) ||
+				cookedFile->getBlob(MeshBlob::Lods).elementCount == 0)
+				cookedFile.reset();
+		}
 
-			archive(vertices, indices);
+		std::vector<Vertex> vertices;
+		std::vector<char>& packedVertices = outData.vertices;
+		std::vector<uint32_t>& indices = outData.indices;
+		std::vector<Meshlet>& meshlets = outData.meshlets;
+		std::vector<MeshLod>& lods = outData.lods;
+
+		const char* vertexData = nullptr;
+		const uint32_t* indexData = nullptr;
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+
+		if (cookedFile)
+		{
+			vertexData = static_cast<const char*>(cookedFile->getBlobData(MeshBlob::Vertices));
+			vertexCount = cookedFile->getBlob(MeshBlob::Vertices).elementCount;
+			indexData = static_cast<const uint32_t*>(cookedFile->getBlobData(MeshBlob::Indices));
+			indexCount = cookedFile->getBlob(MeshBlob::Indices).elementCount;
+			const Meshlet* meshletData = static_cast<const Meshlet*>(cookedFile->getBlobData(MeshBlob::Meshlets));
+			meshlets.assign(meshletData, meshletData + cookedFile->getBlob(MeshBlob::Meshlets).elementCount);
+			const MeshLod* lodData = static_cast<const MeshLod*>(cookedFile->getBlobData(MeshBlob::Lods));
+			lods.assign(lodData, lodData + cookedFile->getBlob(MeshBlob::Lods).elementCount);
+			boundsMin = glm::make_vec3(cookedFile->getHeader().boundsMin);
+			boundsMax = glm::make_vec3(cookedFile->getHeader().boundsMax);
 		}
-		else if (std::filesystem::exists(modelFile) && std::filesystem::is_regular_file(modelFile))
+		else if (sourceFile)
 		{
-		#ifdef TINYOBJLOADER_USE_EXPERIMENTAL
-			using namespace tinyobj_opt;
-		#else
-			using namespace tinyobj;
-		#endif
+			ObjMesh mesh;
+			parseObj(sourceFile->data(), sourceFile->size(), *myLoadJobSystem, mesh);
+
+			deduplicate(static_cast<uint32_t>(mesh.indices.size()), [&mesh](uint32_t indexIt)
+			{
+				const ObjIndex& index = mesh.indices[indexIt];
+
+				Vertex vertex = {};
+
+				vertex.pos =
+				{
+					mesh.positions[3 * index.position + 0],
+					mesh.positions[3 * index.position + 1],
+					mesh.positions[3 * index.position + 2]
+				};
 
-			attrib_t attrib;
-			std::vector<shape_t> shapes;
-			std::vector<material_t> materials;
+				if (index.texcoord >= 0)
+				{
+					vertex.texCoord =
+					{
+						mesh.texcoords[2 * index.texcoord + 0],
+						1.0f - mesh.texcoords[2 * index.texcoord + 1]
+					};
+				}
+
+				vertex.color = { 1.0f, 1.0f, 1.0f };
 
-			std::ifstream file(modelFile.c_str(), std::ios::in|std::ios::binary);
-			file.ignore(std::numeric_limits<std::streamsize>::max());
-			file.clear(); // Since ignore will have set eof.
-			file.seekg(0, std::ios_base::beg);
+				return vertex;
+			}, *myLoadJobSystem, vertices, indices);
 
+			if (myOptimizeModelsFlag && !indices.empty())
 			{
-			#ifdef TINYOBJLOADER_USE_EXPERIMENTAL
-				std::streambuf* raw_buffer = file.rdbuf();
-				std::streamsize bufferSize = file.gcount();
-				std::unique_ptr<char[]> buffer = std::make_unique<char[]>(bufferSize);
-				raw_buffer->sgetn(buffer.get(), bufferSize);
-				LoadOption option;
-				if (!parseObj(&attrib, &shapes, &materials, buffer.get(), bufferSize, option))
-					throw std::runtime_error("Failed to load model.");
-			#else
-				std::string warn, err;
-				if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &file))
-					throw std::runtime_error(err);
-			#endif
+				VertexCacheStatistics before = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+				optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+				optimizeOverdraw(indices.data(), indices.size(), &vertices[0].pos.x, sizeof(Vertex), vertices.size());
+				vertices.resize(optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex), indices.data(), indices.size()));
+
+				VertexCacheStatistics after = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+				if (myVerboseFlag)
+					std::cout << filename << ": ACMR " << before.acmr << " -> " << after.acmr
+						<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
 			}
-		
-			uint32_t indexCount = 0;
-			for (const auto& shape : shapes)
-			#ifdef TINYOBJLOADER_USE_EXPERIMENTAL
-				for (uint32_t faceOffset = shape.face_offset; faceOffset < (shape.face_offset + shape.length); faceOffset++)
-					indexCount += attrib.face_num_verts[faceOffset];
-			#else
-				indexCount += shape.mesh.indices.size();
-			#endif
 
-			std::unordered_map<Vertex, uint32_t> uniqueVertices;
+			boundsMin = glm::vec3(std::numeric_limits<float>::max());
+			boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+			for (const auto& vertex : vertices)
+			{
+				boundsMin = glm::min(boundsMin, vertex.pos);
+				boundsMax = glm::max(boundsMax, vertex.pos);
+			}
 
-			vertices.reserve(indexCount / 3); // guesstimate
-			indices.reserve(indexCount);
+			lods.clear();
+			lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0, 0, 0.0f });
 
-			for (const auto& shape : shapes)
+			// every level is simplified from the one before it and appended to the same index buffer
+			if (!indices.empty())
 			{
-			#ifdef TINYOBJLOADER_USE_EXPERIMENTAL
-				for (uint32_t faceOffset = shape.face_offset; faceOffset < (shape.face_offset + shape.length); faceOffset++)
-				{
-					const index_t& index = attrib.indices[faceOffset];
-			#else
-				for (const auto& index : shape.mesh.indices)
+				constexpr float lodTargetError = 0.05f; // per level, relative to the mesh extent
+				float meshScale = getMeshScale(&vertices[0].pos.x, sizeof(Vertex), vertices.size());
+
+				while (lods.size() < MeshLod::MaxCount)
 				{
-			#endif
-					Vertex vertex = {};
+					MeshLod parent = lods.back();
+
+					std::vector<uint32_t> lodIndices(parent.indexCount);
+					float lodError = 0.0f;
+					lodIndices.resize(simplifyMesh(
+						lodIndices.data(),
+						indices.data() + parent.firstIndex, parent.indexCount,
+						&vertices[0].pos.x, sizeof(Vertex), vertices.size(),
+						parent.indexCount / 2, lodTargetError, &lodError));
+
+					// stop when locked features or the error limit keep it from getting much smaller
+					if (lodIndices.empty() || lodIndices.size() > parent.indexCount * 3 / 4)
+						break;
 
-					vertex.pos =
-					{
-						attrib.vertices[3 * index.vertex_index + 0],
-						attrib.vertices[3 * index.vertex_index + 1],
-						attrib.vertices[3 * index.vertex_index + 2]
-					};
+					if (myOptimizeModelsFlag)
+						optimizeVertexCache(lodIndices.data(), lodIndices.size(), vertices.size());
 
-					vertex.texCoord =
-					{
-						attrib.texcoords[2 * index.texcoord_index + 0],
-						1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-					};
+					MeshLod lod = {};
+					lod.firstIndex = static_cast<uint32_t>(indices.size());
+					lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+					lod.error = parent.error + lodError * meshScale;
 
-					vertex.color = { 1.0f, 1.0f, 1.0f };
+					indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+					lods.push_back(lod);
+				}
+			}
 
-					if (uniqueVertices.count(vertex) == 0)
-					{
-						uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-						vertices.push_back(vertex);
-					}
+			meshlets.clear();
+			for (auto& lod : lods)
+			{
+				if (lod.indexCount == 0)
+					continue;
+
+				std::vector<Meshlet> lodMeshlets;
+				buildMeshlets(
+					indices.data() + lod.firstIndex, lod.indexCount,
+					&vertices[0].pos.x, sizeof(Vertex), vertices.size(),
+					lodMeshlets);
 
-					indices.push_back(uniqueVertices[vertex]);
+				lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+				lod.meshletCount = static_cast<uint32_t>(lodMeshlets.size());
+
+				for (auto& meshlet : lodMeshlets)
+				{
+					meshlet.firstIndex += lod.firstIndex;
+					meshlets.push_back(meshlet);
 				}
+
+				if (myVerboseFlag)
+					std::cout << filename << ": LOD " << (&lod - lods.data()) << ", " << lod.indexCount / 3
+						<< " triangles, error " << lod.error << std::endl;
 			}
 
-			std::ofstream cerealFile(modelFileCereal.c_str(), std::ios::binary);
-			cereal::PortableBinaryOutputArchive archive(cerealFile);
+			packedVertices = packVertices(myVertexFormat, vertices, boundsMin, boundsMax);
+
+			vertexData = packedVertices.data();
+			vertexCount = static_cast<uint32_t>(vertices.size());
+			indexData = indices.data();
+			indexCount = static_cast<uint32_t>(indices.size());
 
-			archive(vertices, indices);
+			MeshFileHeader header;
+			header.sourceHash = sourceHash;
+			std::copy_n(&boundsMin.x, 3, header.boundsMin);
+			std::copy_n(&boundsMax.x, 3, header.boundsMax);
+
+			// the cache is optional, a read only resource directory is fine
+			writeMeshFile(modelFileCooked, header,
+			{
+				{ vertexData, vertexFormat.bindingDescription->stride, vertexCount },
+				{ indexData, sizeof(uint32_t), indexCount },
+				{ meshlets.data(), sizeof(Meshlet), static_cast<uint32_t>(meshlets.size()) },
+				{ lods.data(), sizeof(MeshLod), static_cast<uint32_t>(lods.size()) }
+			});
 		}
 		else
 		{
 			throw std::runtime_error("Failed to load model.");
 		}
 
-		createDeviceLocalBuffer(
-			vertices.data(),
-			static_cast<uint32_t>(vertices.size()),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			outModel.myVertexBuffer,
-			outModel.myVertexBufferMemory,
-			filename);
-			
-		createDeviceLocalBuffer(
-			indices.data(),
-			static_cast<uint32_t>(indices.size()),
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		outData.cookedFile = std::move(cookedFile);
+		outData.vertexData = vertexData;
+		outData.indexData = indexData;
+		outData.vertexCount = vertexCount;
+		outData.indexCount = indexCount;
+		outData.boundsMin = boundsMin;
+		outData.boundsMax = boundsMax;
+	}
+
+	// unit cube drawn until the real model has been loaded
+	void createPlaceholderModel(ModelData& outData) const
+	{
+		std::vector<Vertex> vertices(8);
+		for (uint32_t cornerIt = 0; cornerIt < 8; cornerIt++)
+		{
+			glm::vec3 corner((cornerIt & 1) ? 1.0f : 0.0f, (cornerIt & 2) ? 1.0f : 0.0f, (cornerIt & 4) ? 1.0f : 0.0f);
+
+			vertices[cornerIt].pos = corner - glm::vec3(0.5f);
+			vertices[cornerIt].color = { 1.0f, 1.0f, 1.0f };
+			vertices[cornerIt].texCoord = { corner.x, corner.y };
+		}
+
+		// counter clockwise quads seen from the outside, +x -x +y -y +z -z
+		static const uint32_t quads[6][4] =
+		{
+			{ 1, 3, 7, 5 }, { 0, 4, 6, 2 }, { 2, 6, 7, 3 }, { 0, 1, 5, 4 }, { 4, 5, 7, 6 }, { 0, 2, 3, 1 }
+		};
+
+		for (const auto& quad : quads)
+			outData.indices.insert(outData.indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+
+		outData.boundsMin = glm::vec3(-0.5f);
+		outData.boundsMax = glm::vec3(0.5f);
+		outData.vertices = packVertices(myVertexFormat, vertices, outData.boundsMin, outData.boundsMax);
+		outData.lods.push_back({ 0, static_cast<uint32_t>(outData.indices.size()), 0, 0, 0.0f });
+
+		outData.vertexData = outData.vertices.data();
+		outData.indexData = outData.indices.data();
+		outData.vertexCount = static_cast<uint32_t>(vertices.size());
+		outData.indexCount = static_cast<uint32_t>(outData.indices.size());
+	}
+
+	// creates the model's buffers and records their upload into batch
+	void uploadModel(UploadBatch& batch, const ModelData& data, Model& outModel, const char* debugName)
+	{
+		const VertexFormat& vertexFormat = ourVertexFormats[myVertexFormat];
+
+		createDeviceLocalBuffer(
+			batch,
+			data.vertexData,
+			data.vertexCount * vertexFormat.bindingDescription->stride,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			outModel.myVertexBuffer,
+			outModel.myVertexBufferMemory,
+			debugName);
+			
+		createDeviceLocalBuffer(
+			batch,
+			data.indexData,
+			data.indexCount,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 			outModel.myIndexBuffer,
 			outModel.myIndexBufferMemory,
-			filename);
+			debugName);
 
-		outModel.indexCount = indices.size();
+		outModel.indexCount = data.indexCount;
+		outModel.myDequantizeTransform = getDequantizeTransform(myVertexFormat, data.boundsMin, data.boundsMax);
+		outModel.myBoundingSphere = glm::vec4(0.5f * (data.boundsMin + data.boundsMax), 0.5f * glm::distance(data.boundsMin, data.boundsMax));
+		outModel.myMeshlets = data.meshlets;
+		outModel.myLods = data.lods;
 	}
 
-	void loadTexture(const char* filename, Texture& outTexture) const
+	// decodes an image to rgba8, only touches cpu memory so it can run on any thread
+	void loadTexture(const char* filename, ImageData& outData) const
 	{
 		std::filesystem::path imageFile(myResourcePath);
 		imageFile = std::filesystem::absolute(imageFile);
@@ -482,19 +1055,9 @@ private:
 			if (imageData == nullptr)
 				throw std::runtime_error("Failed to load image.");
 
-			createDeviceLocalImage2D(
-				imageData,
-				x,
-				y,
-				VK_FORMAT_R8G8B8A8_UNORM,
-				VK_IMAGE_USAGE_SAMPLED_BIT,
-				outTexture.myImage,
-				outTexture.myImageMemory,
-				filename);
-
-			stbi_image_free(imageData);
-
-			outTexture.myImageView = createImageView2D(myHouseImage.myImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+			outData.pixels = std::shared_ptr<const unsigned char>(imageData, stbi_image_free);
+			outData.width = x;
+			outData.height = y;
 		}
 		else
 		{
@@ -502,7 +1065,181 @@ private:
 		}
 	}
 
-	void loadSPIRVFile(const char* filename, std::vector<char>& outData)
+	// checkerboard sampled until the real texture has been loaded
+	void createPlaceholderTexture(ImageData& outData) const
+	{
+		constexpr uint32_t size = 8;
+		static const std::array<uint32_t, size * size> pixels = []
+		{
+			std::array<uint32_t, size * size> checker;
+			for (uint32_t pixelIt = 0; pixelIt < size * size; pixelIt++)
+				checker[pixelIt] = ((pixelIt / size + pixelIt % size) & 1) ? 0xffff00ff : 0xff202020;
+			return checker;
+		}();
+
+		outData.pixels = std::shared_ptr<const unsigned char>(reinterpret_cast<const unsigned char*>(pixels.data()), [](const unsigned char*) {});
+		outData.width = size;
+		outData.height = size;
+	}
+
+	// creates the texture's image and view and records the upload into batch
+	void uploadTexture(UploadBatch& batch, const ImageData& data, Texture& outTexture, const char* debugName)
+	{
+		createDeviceLocalImage2D(
+			batch,
+			data.pixels.get(),
+			data.width,
+			data.height,
+			VK_FORMAT_R8G8B8A8_UNORM,
+			VK_IMAGE_USAGE_SAMPLED_BIT,
+			outTexture.myImage,
+			outTexture.myImageMemory,
+			debugName);
+
+		outTexture.myImageView = createImageView2D(outTexture.myImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+
+	// (re)loads every model with the current import settings
+	void loadModels()
+	{
+		loadModelAsync("chalet.obj", myHouseModel);
+	}
+
+	// decodes on the load job system and hands the result to the frame loop, which uploads it
+	void loadModelAsync(const char* filename, Model& outModel)
+	{
+		myPendingLoadCount.fetch_add(1, std::memory_order_relaxed);
+		myLoadJobSystem->submit([this, filename, &outModel]
+		{
+			auto data = std::make_unique<ModelData>();
+
+			try
+			{
+				loadModel(filename, *data);
+
+				std::lock_guard<std::mutex> lock(myLoadedAssetsMutex);
+				myLoadedModels.push_back({ &outModel, std::move(data), filename });
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << filename << ": " << e.what() << std::endl; // the placeholder stays
+			}
+
+			myPendingLoadCount.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	void loadTextureAsync(const char* filename, Texture& outTexture)
+	{
+		myPendingLoadCount.fetch_add(1, std::memory_order_relaxed);
+		myLoadJobSystem->submit([this, filename, &outTexture]
+		{
+			auto data = std::make_unique<ImageData>();
+
+			try
+			{
+				loadTexture(filename, *data);
+
+				std::lock_guard<std::mutex> lock(myLoadedAssetsMutex);
+				myLoadedTextures.push_back({ &outTexture, std::move(data), filename });
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << filename << ": " << e.what() << std::endl; // the placeholder stays
+			}
+
+			myPendingLoadCount.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	// replaces the assets the loader finished since the last frame. all uploads go into one batch
+	// submitted ahead of the frame, and the old resources are released once the frame is done.
+	void uploadLoadedAssets()
+	{
+		std::vector<LoadedModel> loadedModels;
+		std::vector<LoadedTexture> loadedTextures;
+		{
+			std::lock_guard<std::mutex> lock(myLoadedAssetsMutex);
+			loadedModels.swap(myLoadedModels);
+			loadedTextures.swap(myLoadedTextures);
+		}
+
+		if (loadedModels.empty() && loadedTextures.empty())
+			return;
+
+		// retired handles may be handed out again, so cached secondaries can't be matched by them alone
+		myResourceGeneration++;
+
+		UploadBatch batch = beginUploadBatch(UploadQueue::Transfer);
+
+		for (auto& loaded : loadedModels)
+		{
+			Model& model = *loaded.target;
+			deferDestroy([this, vertexBuffer = model.myVertexBuffer, vertexBufferMemory = model.myVertexBufferMemory,
+				indexBuffer = model.myIndexBuffer, indexBufferMemory = model.myIndexBufferMemory]
+			{
+				vmaDestroyBuffer(myAllocator, vertexBuffer, vertexBufferMemory);
+				vmaDestroyBuffer(myAllocator, indexBuffer, indexBufferMemory);
+			});
+
+			uploadModel(batch, *loaded.data, model, loaded.name.c_str());
+		}
+
+		for (auto& loaded : loadedTextures)
+		{
+			Texture& texture = *loaded.target;
+			deferDestroy([this, image = texture.myImage, imageMemory = texture.myImageMemory, imageView = texture.myImageView]
+			{
+				myDeviceTable.vkDestroyImageView(myDevice, imageView, nullptr);
+				vmaDestroyImage(myAllocator, image, imageMemory);
+			});
+
+			// frames in flight may still sample the old table slot, so the new view goes into a free one
+			if (myTextureTableSet != VK_NULL_HANDLE && texture.myImageView != VK_NULL_HANDLE)
+				deferDestroy([this, tableIndex = texture.myTableIndex]
+				{
+					myFreeTextureTableSlots.push_back(tableIndex);
+				});
+
+			uploadTexture(batch, *loaded.data, texture, loaded.name.c_str());
+
+			if (myTextureTableSet != VK_NULL_HANDLE)
+			{
+				texture.myTableIndex = allocateTextureTableSlot();
+				updateTextureTable(texture.myTableIndex, texture.myImageView);
+			}
+		}
+
+		submitUploadBatch(std::move(batch));
+
+		// frames in flight still use the current set, so the new textures go into a new one
+		if (!loadedTextures.empty())
+		{
+			if (myDescriptorSet != VK_NULL_HANDLE)
+				deferDestroy([this, descriptorSet = myDescriptorSet]
+				{
+					CHECK_VK(myDeviceTable.vkFreeDescriptorSets(myDevice, myDescriptorPool, 1, &descriptorSet));
+				});
+
+			createDescriptorSet();
+		}
+	}
+
+	// runs destroyFunction once the gpu is done with the frame being recorded
+	void deferDestroy(std::function<void()>&& destroyFunction)
+	{
+		myFrameDeletionQueues[myWindowData->FrameIndex].emplace_back(std::move(destroyFunction));
+	}
+
+	void runDeferredDestroys(uint32_t frameIndex)
+	{
+		for (auto& destroyFunction : myFrameDeletionQueues[frameIndex])
+			destroyFunction();
+
+		myFrameDeletionQueues[frameIndex].clear();
+	}
+
+	std::filesystem::path getSPIRVFilePath(const char* filename) const
 	{
 		std::filesystem::path spirvFile(myResourcePath);
 		spirvFile = std::filesystem::absolute(spirvFile);
@@ -511,6 +1248,21 @@ private:
 		spirvFile /= "spir-v";
 		spirvFile /= filename;
 
+		return spirvFile;
+	}
+
+	// only vert.spv and frag.spv are checked in, the other variants need the shader build step
+	bool hasSPIRVFile(const char* filename) const
+	{
+		std::filesystem::path spirvFile = getSPIRVFilePath(filename);
+
+		return std::filesystem::exists(spirvFile) && std::filesystem::is_regular_file(spirvFile);
+	}
+
+	void loadSPIRVFile(const char* filename, std::vector<char>& outData)
+	{
+		std::filesystem::path spirvFile = getSPIRVFilePath(filename);
+
 		if (std::filesystem::exists(spirvFile) && std::filesystem::is_regular_file(spirvFile))
 		{
 			std::ifstream file(spirvFile.c_str(), std::ios::ate | std::ios::binary);
@@ -539,6 +1291,9 @@ private:
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.apiVersion = VK_API_VERSION_1_1;
 
+		const char* validationLayerName = "VK_LAYER_LUNARG_standard_validation";
+		std::vector<const char*> enabledLayerNames;
+
 		uint32_t instanceLayerCount;
 		CHECK_VK(vkEnumerateInstanceLayerProperties(&instanceLayerCount, nullptr));
 		std::cout << instanceLayerCount << " layers found!\n";
@@ -548,10 +1303,14 @@ private:
 				new VkLayerProperties[instanceLayerCount]);
 			CHECK_VK(vkEnumerateInstanceLayerProperties(&instanceLayerCount, instanceLayers.get()));
 			for (uint32_t i = 0; i < instanceLayerCount; ++i)
+			{
 				std::cout << instanceLayers[i].layerName << "\n";
-		}
 
-		const char* enabledLayerNames[] = { "VK_LAYER_LUNARG_standard_validation" };
+				// CI machines running a software ICD usually don't have the validation layers installed
+				if (strcmp(instanceLayers[i].layerName, validationLayerName) == 0)
+					enabledLayerNames.push_back(validationLayerName);
+			}
+		}
 
 		uint32_t instanceExtensionCount;
 		vkEnumerateInstanceExtensionProperties(nullptr, &instanceExtensionCount, nullptr);
@@ -591,6 +1350,9 @@ private:
 #endif
 		};
 
+		if (myHeadlessFlag)
+			requiredExtensions = { "VK_EXT_debug_report" };
+
 		assert(
 			std::includes(instanceExtensions.begin(), instanceExtensions.end(),
 				requiredExtensions.begin(), requiredExtensions.end(),
@@ -602,8 +1364,8 @@ private:
 		VkInstanceCreateInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		info.pApplicationInfo = &appInfo;
-		info.enabledLayerCount = 1;
-		info.ppEnabledLayerNames = enabledLayerNames;
+		info.enabledLayerCount = static_cast<uint32_t>(enabledLayerNames.size());
+		info.ppEnabledLayerNames = enabledLayerNames.data();
 		info.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
 		info.ppEnabledExtensionNames = requiredExtensions.data();
 
@@ -710,6 +1472,13 @@ private:
 			{
 				myPhysicalDevice = device;
 
+				if (myHeadlessFlag)
+				{
+					mySurfaceFormat = { VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+					myFrameCount = 2;
+					break;
+				}
+
 				const VkFormat requestSurfaceImageFormat[] =
 				{
 					VK_FORMAT_B8G8R8A8_UNORM,
@@ -764,16 +1533,42 @@ private:
 		if (myPhysicalDevice == VK_NULL_HANDLE)
 			throw std::runtime_error("failed to find a suitable GPU!");
 
-		const float graphicsQueuePriority = 1.0f;
+		// uploads go to a separate queue if there is one, preferably of a dedicated transfer family,
+		// otherwise a second queue of the graphics family, otherwise the graphics queue itself
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(myPhysicalDevice, &queueFamilyCount, nullptr);
+
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(myPhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+		int transferQueueFamilyIndex = findTransferQueueFamily(myPhysicalDevice, myQueueFamilyIndex);
+		uint32_t graphicsQueueCount = (transferQueueFamilyIndex < 0 && queueFamilies[myQueueFamilyIndex].queueCount > 1) ? 2 : 1;
+
+		const float queuePriorities[] = { 1.0f, 0.5f };
+
+		VkDeviceQueueCreateInfo queueCreateInfos[2] = {};
+		uint32_t queueCreateInfoCount = 0;
 
-		VkDeviceQueueCreateInfo queueCreateInfo = {};
-		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo.queueFamilyIndex = myQueueFamilyIndex;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &graphicsQueuePriority;
+		queueCreateInfos[queueCreateInfoCount].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfos[queueCreateInfoCount].queueFamilyIndex = myQueueFamilyIndex;
+		queueCreateInfos[queueCreateInfoCount].queueCount = graphicsQueueCount;
+		queueCreateInfos[queueCreateInfoCount++].pQueuePriorities = queuePriorities;
+
+		if (transferQueueFamilyIndex >= 0)
+		{
+			queueCreateInfos[queueCreateInfoCount].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queueCreateInfos[queueCreateInfoCount].queueFamilyIndex = transferQueueFamilyIndex;
+			queueCreateInfos[queueCreateInfoCount].queueCount = 1;
+			queueCreateInfos[queueCreateInfoCount++].pQueuePriorities = &queuePriorities[1];
+		}
+
+		vkGetPhysicalDeviceFeatures(myPhysicalDevice, &myPhysicalDeviceFeatures);
 
 		VkPhysicalDeviceFeatures deviceFeatures = {};
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.samplerAnisotropy = myPhysicalDeviceFeatures.samplerAnisotropy;
+		deviceFeatures.multiViewport = myPhysicalDeviceFeatures.multiViewport;
+		deviceFeatures.multiDrawIndirect = myPhysicalDeviceFeatures.multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance = myPhysicalDeviceFeatures.drawIndirectFirstInstance;
 
 		uint32_t deviceExtensionCount;
 		vkEnumerateDeviceExtensionProperties(myPhysicalDevice, nullptr, &deviceExtensionCount,
@@ -805,15 +1600,82 @@ private:
 			"VK_KHR_swapchain"
 		};
 
+		if (myHeadlessFlag)
+			requiredDeviceExtensions.clear();
+
 		assert(
 			std::includes(deviceExtensions.begin(), deviceExtensions.end(),
 				requiredDeviceExtensions.begin(), requiredDeviceExtensions.end(),
 				[](const char* lhs, const char* rhs) { return strcmp(lhs, rhs) < 0; }));
 
+		// instanced draws pick their tile's viewport in the vertex shader
+		bool viewportIndexLayerSupported = std::binary_search(deviceExtensions.begin(), deviceExtensions.end(),
+			"VK_EXT_shader_viewport_index_layer",
+			[](const char* lhs, const char* rhs) { return strcmp(lhs, rhs) < 0; });
+
+		if (myPhysicalDeviceFeatures.multiViewport && viewportIndexLayerSupported)
+		{
+			requiredDeviceExtensions.push_back("VK_EXT_shader_viewport_index_layer");
+
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(myPhysicalDevice, &properties);
+
+			myInstancedViewportCount = std::min(properties.limits.maxViewports, NX * NY);
+		}
+
+		// gpu culling turns every instanced draw into indirect draws of single instances, which keep their
+		// index through firstInstance. the draw count is read on the gpu if the device can.
+		if (myInstancedViewportCount > 0 && myPhysicalDeviceFeatures.drawIndirectFirstInstance)
+		{
+			myGpuCullingSupported = true;
+
+			if (std::binary_search(deviceExtensions.begin(), deviceExtensions.end(),
+				"VK_KHR_draw_indirect_count",
+				[](const char* lhs, const char* rhs) { return strcmp(lhs, rhs) < 0; }))
+			{
+				requiredDeviceExtensions.push_back("VK_KHR_draw_indirect_count");
+				myDrawIndirectCountSupported = true;
+			}
+		}
+
+		// the bindless texture table is indexed by a push constant, partially bound, and slots are written
+		// while the table is bound
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {};
+		descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+		if (myPhysicalDeviceFeatures.shaderSampledImageArrayDynamicIndexing &&
+			std::binary_search(deviceExtensions.begin(), deviceExtensions.end(),
+				"VK_EXT_descriptor_indexing",
+				[](const char* lhs, const char* rhs) { return strcmp(lhs, rhs) < 0; }))
+		{
+			VkPhysicalDeviceFeatures2 features = {};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features.pNext = &descriptorIndexingFeatures;
+			vkGetPhysicalDeviceFeatures2(myPhysicalDevice, &features);
+
+			myTextureTableSupported =
+				descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+				descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+				descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledDescriptorIndexingFeatures = {};
+		enabledDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		enabledDescriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		enabledDescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		enabledDescriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+		if (myTextureTableSupported)
+		{
+			requiredDeviceExtensions.push_back("VK_EXT_descriptor_indexing");
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+		}
+
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
-		deviceCreateInfo.queueCreateInfoCount = 1;
+		deviceCreateInfo.pNext = myTextureTableSupported ? &enabledDescriptorIndexingFeatures : nullptr;
+		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
+		deviceCreateInfo.queueCreateInfoCount = queueCreateInfoCount;
 		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtensions.size());
 		deviceCreateInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
@@ -823,6 +1685,17 @@ private:
 		volkLoadDeviceTable(&myDeviceTable, myDevice);
 		VkDeviceTable vk(myDevice, myDeviceTable);
 		vk.vkGetDeviceQueue(myQueueFamilyIndex, 0, &myQueue);
+
+		if (transferQueueFamilyIndex >= 0)
+		{
+			myTransferQueueFamilyIndex = transferQueueFamilyIndex;
+			vk.vkGetDeviceQueue(myTransferQueueFamilyIndex, 0, &myTransferQueue);
+		}
+		else
+		{
+			myTransferQueueFamilyIndex = myQueueFamilyIndex;
+			vk.vkGetDeviceQueue(myQueueFamilyIndex, graphicsQueueCount - 1, &myTransferQueue);
+		}
 	}
 
 	void createAllocator()
@@ -854,6 +1727,234 @@ private:
 		vmaCreateAllocator(&allocatorInfo, &myAllocator);
 	}
 
+	// One partition of NX * NY dynamic uniform buffer slots per frame in flight. A frame only writes
+	// its own partition, after its fence has been waited, so frames in flight are never overwritten.
+	void createUniformBuffer()
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(myPhysicalDevice, &properties);
+
+		VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+		myUniformBufferStride = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+		myUniformBufferFrameSize = NX * NY * myUniformBufferStride;
+
+		void* data;
+		createBuffer(
+			myFrameCount * myUniformBufferFrameSize,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			myUniformBuffer,
+			myUniformBufferMemory,
+			"myUniformBuffer",
+			&data);
+
+		myUniformBufferData = static_cast<char*>(data);
+	}
+
+	inline uint32_t getUniformBufferOffset(uint32_t frameIndex, uint32_t drawIndex) const
+	{
+		return static_cast<uint32_t>(frameIndex * myUniformBufferFrameSize + drawIndex * myUniformBufferStride);
+	}
+
+	// NX * NY instance vertices per frame in flight, partitioned like the uniform buffer. The
+	// transforms are rewritten every frame, viewport indices are only written here: instance n is
+	// drawn to viewport n % myInstancedViewportCount by draw n / myInstancedViewportCount.
+	void createInstanceBuffer()
+	{
+		if (myInstancedViewportCount == 0)
+			return;
+
+		void* data;
+		createBuffer(
+			myFrameCount * NX * NY * sizeof(InstanceVertex),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			myInstanceBuffer,
+			myInstanceBufferMemory,
+			"myInstanceBuffer",
+			&data);
+
+		myInstanceBufferData = static_cast<InstanceVertex*>(data);
+
+		for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
+			for (uint32_t n = 0; n < NX * NY; n++)
+				myInstanceBufferData[frameIt * NX * NY + n].viewportIndex = n % myInstancedViewportCount;
+
+		vmaFlushAllocation(myAllocator, myInstanceBufferMemory, 0, VK_WHOLE_SIZE);
+	}
+
+	// The cull input is written by the cpu every frame, one partition per frame in flight: a CullInput
+	// header and the NX * NY draw transforms. The draw commands and counts are only written by the
+	// cull shader and read by the draws of the same frame, so a single buffer is shared by all frames.
+	void createCullResources()
+	{
+		// cull.spv is only built by the shader build step
+		if (!hasSPIRVFile("cull.spv"))
+			myGpuCullingSupported = false;
+
+		if (!myGpuCullingSupported)
+			return;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(myPhysicalDevice, &properties);
+
+		VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
+		VkDeviceSize cullInputSize = sizeof(CullInput) + NX * NY * sizeof(InstanceDrawTransform);
+		myCullInputFrameSize = (cullInputSize + alignment - 1) / alignment * alignment;
+
+		void* data;
+		createBuffer(
+			myFrameCount * myCullInputFrameSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			myCullInputBuffer,
+			myCullInputBufferMemory,
+			"myCullInputBuffer",
+			&data);
+
+		myCullInputBufferData = static_cast<char*>(data);
+
+		// draw d of drawInstanced() owns commands [d * myInstancedViewportCount, (d + 1) * myInstancedViewportCount)
+		uint32_t drawCount = (NX * NY + myInstancedViewportCount - 1) / myInstancedViewportCount;
+		VkDeviceSize drawCommandsSize = NX * NY * sizeof(VkDrawIndexedIndirectCommand);
+		myDrawCountOffset = (drawCommandsSize + alignment - 1) / alignment * alignment;
+
+		createBuffer(
+			myDrawCountOffset + drawCount * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			myDrawCommandBuffer,
+			myDrawCommandBufferMemory,
+			"myDrawCommandBuffer");
+
+		std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+		for (uint32_t bindingIt = 0; bindingIt < bindings.size(); bindingIt++)
+		{
+			bindings[bindingIt].binding = bindingIt;
+			bindings[bindingIt].descriptorType = bindingIt == 0 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+				: VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[bindingIt].descriptorCount = 1;
+			bindings[bindingIt].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		CHECK_VK(myDeviceTable.vkCreateDescriptorSetLayout(myDevice, &layoutInfo, nullptr, &myCullDescriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = myDescriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &myCullDescriptorSetLayout;
+
+		CHECK_VK(myDeviceTable.vkAllocateDescriptorSets(myDevice, &allocInfo, &myCullDescriptorSet));
+
+		std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+		bufferInfos[0] = { myCullInputBuffer, 0, cullInputSize }; // per frame, the dynamic offset selects the partition
+		bufferInfos[1] = { myDrawCommandBuffer, 0, drawCommandsSize };
+		bufferInfos[2] = { myDrawCommandBuffer, myDrawCountOffset, drawCount * sizeof(uint32_t) };
+
+		std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+		for (uint32_t bindingIt = 0; bindingIt < descriptorWrites.size(); bindingIt++)
+		{
+			descriptorWrites[bindingIt].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[bindingIt].dstSet = myCullDescriptorSet;
+			descriptorWrites[bindingIt].dstBinding = bindingIt;
+			descriptorWrites[bindingIt].dstArrayElement = 0;
+			descriptorWrites[bindingIt].descriptorType = bindings[bindingIt].descriptorType;
+			descriptorWrites[bindingIt].descriptorCount = 1;
+			descriptorWrites[bindingIt].pBufferInfo = &bufferInfos[bindingIt];
+		}
+
+		myDeviceTable.vkUpdateDescriptorSets(myDevice, static_cast<uint32_t>(descriptorWrites.size()),
+			descriptorWrites.data(), 0, nullptr);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &myCullDescriptorSetLayout;
+
+		CHECK_VK(myDeviceTable.vkCreatePipelineLayout(myDevice, &pipelineLayoutInfo, nullptr, &myCullPipelineLayout));
+
+		std::vector<char> csCode;
+		loadSPIRVFile("cull.spv", csCode);
+
+		VkShaderModuleCreateInfo csCreateInfo = {};
+		csCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		csCreateInfo.codeSize = csCode.size();
+		csCreateInfo.pCode = reinterpret_cast<const uint32_t*>(csCode.data());
+
+		VkShaderModule csModule;
+		CHECK_VK(myDeviceTable.vkCreateShaderModule(myDevice, &csCreateInfo, nullptr, &csModule));
+
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = csModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = myCullPipelineLayout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		CHECK_VK(myDeviceTable.vkCreateComputePipelines(myDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &myCullPipeline));
+
+		myDeviceTable.vkDestroyShaderModule(myDevice, csModule, nullptr);
+	}
+
+	void createStagingRing()
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(myPhysicalDevice, &properties);
+
+		// 16 covers the texel size of every power of two sized format, which image copies need on top
+		myStagingAlignment = std::max<VkDeviceSize>(properties.limits.optimalBufferCopyOffsetAlignment, 16);
+		assert((myStagingAlignment & (myStagingAlignment - 1)) == 0);
+
+		void* data;
+		createBuffer(StagingRingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			myStagingBuffer, myStagingBufferMemory, "myStagingBuffer", &data);
+
+		myStagingBufferData = static_cast<char*>(data);
+		myStagingRing = std::make_unique<RingAllocator>(StagingRingSize, myFrameCount);
+	}
+
+	// Returns host memory for size bytes that batch may read. Comes from the staging ring, or from a
+	// buffer of its own if the ring is full or size is too large for it.
+	void* allocateStaging(UploadBatch& batch, VkDeviceSize size, VkBuffer& outBuffer, VkDeviceSize& outOffset, const char* debugName)
+	{
+		outOffset = myStagingRing->allocate(size, myStagingAlignment);
+		if (outOffset != RingAllocator::InvalidOffset)
+		{
+			outBuffer = myStagingBuffer;
+			return myStagingBufferData + outOffset;
+		}
+
+		VmaAllocation stagingBufferMemory;
+		char buf[64];
+		strcpy(buf, debugName);
+		strcat(buf, "_staging");
+		createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			outBuffer, stagingBufferMemory, buf);
+
+		void* data;
+		CHECK_VK(vmaMapMemory(myAllocator, stagingBufferMemory, &data));
+
+		batch.destroyFunctions.emplace_back([this, stagingBuffer = outBuffer, stagingBufferMemory]
+		{
+			vmaUnmapMemory(myAllocator, stagingBufferMemory);
+			vmaDestroyBuffer(myAllocator, stagingBuffer, stagingBufferMemory);
+		});
+
+		outOffset = 0;
+		return data;
+	}
+
 	void createDescriptorPool()
 	{
 		constexpr uint32_t maxDescriptorCount = 1000;
@@ -929,7 +2030,7 @@ private:
 		VkDescriptorBufferInfo bufferInfo = {};
 		bufferInfo.buffer = buffer;
 		bufferInfo.offset = 0;
-		bufferInfo.range = VK_WHOLE_SIZE;
+		bufferInfo.range = sizeof(UniformBufferObject); // per draw, the dynamic offset selects the slot
 
 		VkDescriptorImageInfo imageInfo = {};
 		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -956,7 +2057,99 @@ private:
 			descriptorWrites.data(), 0, nullptr);
 	}
 
-	void createRenderPass()
+	// One set of TextureTableSize combined image samplers, bound as set 1 by the bindless pipelines and
+	// indexed with DrawPushConstants::textureIndex. Slots that were never written are left unbound, and
+	// slots that no frame in flight samples are written while the set is bound.
+	void createTextureTable()
+	{
+		if (!myTextureTableSupported)
+			return;
+
+		VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, TextureTableSize };
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		CHECK_VK(myDeviceTable.vkCreateDescriptorPool(myDevice, &poolInfo, nullptr, &myTextureTablePool));
+
+		std::vector<VkSampler> immutableSamplers(TextureTableSize, mySampler);
+
+		VkDescriptorSetLayoutBinding binding = {};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		binding.descriptorCount = TextureTableSize;
+		binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		binding.pImmutableSamplers = immutableSamplers.data();
+
+		// free slots are written while frames using other slots are pending
+		VkDescriptorBindingFlagsEXT bindingFlags =
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = 1;
+		bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+
+		CHECK_VK(myDeviceTable.vkCreateDescriptorSetLayout(myDevice, &layoutInfo, nullptr, &myTextureTableSetLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = myTextureTablePool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &myTextureTableSetLayout;
+
+		CHECK_VK(myDeviceTable.vkAllocateDescriptorSets(myDevice, &allocInfo, &myTextureTableSet));
+
+		// handed out lowest first
+		myFreeTextureTableSlots.resize(TextureTableSize);
+		for (uint32_t slotIt = 0; slotIt < TextureTableSize; slotIt++)
+			myFreeTextureTableSlots[slotIt] = TextureTableSize - 1 - slotIt;
+	}
+
+	uint32_t allocateTextureTableSlot()
+	{
+		if (myFreeTextureTableSlots.empty())
+			throw std::runtime_error("texture table is full!");
+
+		uint32_t slot = myFreeTextureTableSlots.back();
+		myFreeTextureTableSlots.pop_back();
+
+		return slot;
+	}
+
+	void updateTextureTable(uint32_t slot, VkImageView imageView)
+	{
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = imageView;
+		imageInfo.sampler = mySampler;
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = myTextureTableSet;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = slot;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		myDeviceTable.vkUpdateDescriptorSets(myDevice, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	void createRenderPass()
 	{
 		VkAttachmentDescription colorAttachment = {};
 		colorAttachment.format = myWindowData->SurfaceFormat.format;
@@ -966,7 +2159,8 @@ private:
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachment.finalLayout = myHeadlessFlag ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+			: VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 		VkAttachmentDescription depthAttachment = {};
 		depthAttachment.format = myDepthFormat;
@@ -1015,8 +2209,10 @@ private:
 
 	void createGraphicsPipelines()
 	{
+		const VertexFormat& vertexFormat = ourVertexFormats[myVertexFormat];
+
 		std::vector<char> vsCode;
-		loadSPIRVFile("vert.spv", vsCode);
+		loadSPIRVFile(vertexFormat.vertexShaderFile, vsCode);
 
 		VkShaderModuleCreateInfo vsCreateInfo = {};
 		vsCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -1072,16 +2268,12 @@ private:
 
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vsStageInfo, fsStageInfo };
 
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.vertexAttributeDescriptionCount =
-			static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		vertexInputInfo.pVertexBindingDescriptions = vertexFormat.bindingDescription;
+		vertexInputInfo.vertexAttributeDescriptionCount = vertexFormat.attributeDescriptionCount;
+		vertexInputInfo.pVertexAttributeDescriptions = vertexFormat.attributeDescriptions;
 
 		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -1179,6 +2371,21 @@ private:
 
 		CHECK_VK(myDeviceTable.vkCreatePipelineLayout(myDevice, &pipelineLayoutInfo, nullptr, &myPipelineLayout));
 
+		// the texture table is set 1, if there is one
+		VkDescriptorSetLayout pushConstantSetLayouts[] = { myDescriptorSetLayout, myTextureTableSetLayout };
+
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DrawPushConstants);
+
+		pipelineLayoutInfo.setLayoutCount = myTextureTableSetLayout != VK_NULL_HANDLE ? 2 : 1;
+		pipelineLayoutInfo.pSetLayouts = pushConstantSetLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		CHECK_VK(myDeviceTable.vkCreatePipelineLayout(myDevice, &pipelineLayoutInfo, nullptr, &myPushConstantPipelineLayout));
+
 		VkGraphicsPipelineCreateInfo pipelineInfo = {};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelineInfo.stageCount = 2;
@@ -1192,7 +2399,7 @@ private:
 		pipelineInfo.pColorBlendState = &colorBlending;
 		pipelineInfo.pDynamicState = &dynamicState;
 		pipelineInfo.layout = myPipelineLayout;
-		pipelineInfo.renderPass = myWindowData->RenderPass;
+		pipelineInfo.renderPass = myRenderPass;
 		pipelineInfo.subpass = 0;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineInfo.basePipelineIndex = -1;
@@ -1215,52 +2422,351 @@ private:
 			nullptr,
 			&myGraphicsPipelines.data[GraphicsPipelines::AlphaTest]));
 
+		if (hasSPIRVFile(vertexFormat.pushConstantVertexShaderFile))
+		{
+			std::vector<char> pushConstantVsCode;
+			loadSPIRVFile(vertexFormat.pushConstantVertexShaderFile, pushConstantVsCode);
+
+			VkShaderModuleCreateInfo pushConstantVsCreateInfo = {};
+			pushConstantVsCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			pushConstantVsCreateInfo.codeSize = pushConstantVsCode.size();
+			pushConstantVsCreateInfo.pCode = reinterpret_cast<const uint32_t*>(pushConstantVsCode.data());
+
+			VkShaderModule pushConstantVsModule;
+			CHECK_VK(myDeviceTable.vkCreateShaderModule(myDevice, &pushConstantVsCreateInfo, nullptr, &pushConstantVsModule));
+
+			shaderStages[0].module = pushConstantVsModule;
+			pipelineInfo.layout = myPushConstantPipelineLayout;
+
+			alphaTestSpecializationData.alphaTestMethod = 0;
+			CHECK_VK(myDeviceTable.vkCreateGraphicsPipelines(
+				myDevice,
+				VK_NULL_HANDLE,
+				1,
+				&pipelineInfo,
+				nullptr,
+				&myPushConstantGraphicsPipelines.data[GraphicsPipelines::NoAlphaTest]));
+
+			alphaTestSpecializationData.alphaTestMethod = 1;
+			CHECK_VK(myDeviceTable.vkCreateGraphicsPipelines(
+				myDevice,
+				VK_NULL_HANDLE,
+				1,
+				&pipelineInfo,
+				nullptr,
+				&myPushConstantGraphicsPipelines.data[GraphicsPipelines::AlphaTest]));
+
+			if (myTextureTableSetLayout != VK_NULL_HANDLE && hasSPIRVFile("frag_bindless.spv"))
+			{
+				std::vector<char> bindlessFsCode;
+				loadSPIRVFile("frag_bindless.spv", bindlessFsCode);
+
+				VkShaderModuleCreateInfo bindlessFsCreateInfo = {};
+				bindlessFsCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+				bindlessFsCreateInfo.codeSize = bindlessFsCode.size();
+				bindlessFsCreateInfo.pCode = reinterpret_cast<const uint32_t*>(bindlessFsCode.data());
+
+				VkShaderModule bindlessFsModule;
+				CHECK_VK(myDeviceTable.vkCreateShaderModule(myDevice, &bindlessFsCreateInfo, nullptr, &bindlessFsModule));
+
+				shaderStages[1].module = bindlessFsModule;
+
+				alphaTestSpecializationData.alphaTestMethod = 0;
+				CHECK_VK(myDeviceTable.vkCreateGraphicsPipelines(
+					myDevice,
+					VK_NULL_HANDLE,
+					1,
+					&pipelineInfo,
+					nullptr,
+					&myBindlessGraphicsPipelines.data[GraphicsPipelines::NoAlphaTest]));
+
+				alphaTestSpecializationData.alphaTestMethod = 1;
+				CHECK_VK(myDeviceTable.vkCreateGraphicsPipelines(
+					myDevice,
+					VK_NULL_HANDLE,
+					1,
+					&pipelineInfo,
+					nullptr,
+					&myBindlessGraphicsPipelines.data[GraphicsPipelines::AlphaTest]));
+
+				shaderStages[1].module = fsModule;
+
+				myDeviceTable.vkDestroyShaderModule(myDevice, bindlessFsModule, nullptr);
+			}
+
+			pipelineInfo.layout = myPipelineLayout;
+
+			myDeviceTable.vkDestroyShaderModule(myDevice, pushConstantVsModule, nullptr);
+		}
+
+		if (myInstancedViewportCount > 0 && hasSPIRVFile(vertexFormat.instancedVertexShaderFile))
+		{
+			std::vector<char> instancedVsCode;
+			loadSPIRVFile(vertexFormat.instancedVertexShaderFile, instancedVsCode);
+
+			VkShaderModuleCreateInfo instancedVsCreateInfo = {};
+			instancedVsCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			instancedVsCreateInfo.codeSize = instancedVsCode.size();
+			instancedVsCreateInfo.pCode = reinterpret_cast<const uint32_t*>(instancedVsCode.data());
+
+			VkShaderModule instancedVsModule;
+			CHECK_VK(myDeviceTable.vkCreateShaderModule(myDevice, &instancedVsCreateInfo, nullptr, &instancedVsModule));
+
+			shaderStages[0].module = instancedVsModule;
+
+			VkVertexInputBindingDescription instancedBindingDescriptions[] = { *vertexFormat.bindingDescription, ourInstanceBindingDescription };
+			std::vector<VkVertexInputAttributeDescription> instancedAttributeDescriptions(
+				vertexFormat.attributeDescriptions,
+				vertexFormat.attributeDescriptions + vertexFormat.attributeDescriptionCount);
+			instancedAttributeDescriptions.insert(instancedAttributeDescriptions.end(),
+				std::begin(ourInstanceAttributeDescriptions), std::end(ourInstanceAttributeDescriptions));
+
+			vertexInputInfo.vertexBindingDescriptionCount = 2;
+			vertexInputInfo.pVertexBindingDescriptions = instancedBindingDescriptions;
+			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedAttributeDescriptions.size());
+			vertexInputInfo.pVertexAttributeDescriptions = instancedAttributeDescriptions.data();
+
+			// all of them dynamic, one per instance of a draw
+			viewportState.viewportCount = myInstancedViewportCount;
+			viewportState.pViewports = nullptr;
+			viewportState.scissorCount = myInstancedViewportCount;
+			viewportState.pScissors = nullptr;
+
+			alphaTestSpecializationData.alphaTestMethod = 0;
+			CHECK_VK(myDeviceTable.vkCreateGraphicsPipelines(
+				myDevice,
+				VK_NULL_HANDLE,
+				1,
+				&pipelineInfo,
+				nullptr,
+				&myInstancedGraphicsPipelines.data[GraphicsPipelines::NoAlphaTest]));
+
+			alphaTestSpecializationData.alphaTestMethod = 1;
+			CHECK_VK(myDeviceTable.vkCreateGraphicsPipelines(
+				myDevice,
+				VK_NULL_HANDLE,
+				1,
+				&pipelineInfo,
+				nullptr,
+				&myInstancedGraphicsPipelines.data[GraphicsPipelines::AlphaTest]));
+
+			myDeviceTable.vkDestroyShaderModule(myDevice, instancedVsModule, nullptr);
+		}
+
 		myDeviceTable.vkDestroyShaderModule(myDevice, vsModule, nullptr);
 		myDeviceTable.vkDestroyShaderModule(myDevice, fsModule, nullptr);
 	}
 
-	VkCommandBuffer beginSingleTimeCommands() const
+	void createUploadResources()
+	{
+		const int queueFamilyIndices[UploadQueue::Count] = { myQueueFamilyIndex, myTransferQueueFamilyIndex };
+
+		for (uint32_t queueIt = 0; queueIt < UploadQueue::Count; queueIt++)
+		{
+			VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+			cmdPoolInfo.queueFamilyIndex = queueFamilyIndices[queueIt];
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			CHECK_VK(vkCreateCommandPool(myDevice, &cmdPoolInfo, nullptr, &myUploadCommandPools[queueIt]));
+		}
+
+		myUploadCompleteSemaphores.resize(myFrameCount);
+		for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
+		{
+			VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+			CHECK_VK(vkCreateSemaphore(myDevice, &semaphoreInfo, nullptr, &myUploadCompleteSemaphores[frameIt]));
+		}
+	}
+
+	// starts recording copies and barriers for any number of uploads into one command buffer
+	UploadBatch beginUploadBatch(uint32_t queue)
 	{
-		VkCommandPool commandPool = myWindowData->Frames[myWindowData->FrameIndex].CommandPool;
-		VkCommandBuffer commandBuffer =
-			myWindowData->Frames[myWindowData->FrameIndex].CommandBuffer;
+		UploadBatch batch;
+
+		if (!myFreeUploadBatches[queue].empty())
+		{
+			batch = std::move(myFreeUploadBatches[queue].back());
+			myFreeUploadBatches[queue].pop_back();
+
+			CHECK_VK(myDeviceTable.vkResetFences(myDevice, 1, &batch.fence));
+			CHECK_VK(vkResetCommandBuffer(batch.commandBuffer, 0));
+		}
+		else
+		{
+			batch.queue = queue;
 
-		CHECK_VK(myDeviceTable.vkResetCommandPool(myDevice, commandPool, 0));
+			VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			cmdInfo.commandPool = myUploadCommandPools[queue];
+			cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			cmdInfo.commandBufferCount = 1;
+			CHECK_VK(vkAllocateCommandBuffers(myDevice, &cmdInfo, &batch.commandBuffer));
+
+			VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+			CHECK_VK(vkCreateFence(myDevice, &fenceInfo, nullptr, &batch.fence));
+		}
 
 		VkCommandBufferBeginInfo beginInfo = {};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+		CHECK_VK(vkBeginCommandBuffer(batch.commandBuffer, &beginInfo));
 
-		return commandBuffer;
+		return batch;
 	}
 
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer) const
+	// Submits the batch with its own fence and keeps it in flight until releaseUploadBatches() sees
+	// the fence signaled. The frame being recorded can use the uploaded resources without waiting on
+	// the fence: on the frame queue the batch's barriers order it before the frame, on a separate
+	// transfer queue the frame waits for the batch's semaphore, and when the queue families differ
+	// the frame also acquires the ownership the batch released.
+	void submitUploadBatch(UploadBatch&& batch)
 	{
-		VkSubmitInfo endInfo = {};
-		endInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		endInfo.commandBufferCount = 1;
-		endInfo.pCommandBuffers = &commandBuffer;
-		CHECK_VK(vkEndCommandBuffer(commandBuffer));
-		CHECK_VK(vkQueueSubmit(myQueue, 1, &endInfo, VK_NULL_HANDLE));
-		CHECK_VK(myDeviceTable.vkDeviceWaitIdle(myDevice));
+		VkQueue queue = batch.queue == UploadQueue::Transfer ? myTransferQueue : myQueue;
+		bool ownershipTransfer = batch.queue == UploadQueue::Transfer && myTransferQueueFamilyIndex != myQueueFamilyIndex;
+
+		constexpr VkPipelineStageFlags uploadReadStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+		if (ownershipTransfer)
+		{
+			for (auto& barrier : batch.bufferBarriers)
+			{
+				barrier.srcQueueFamilyIndex = myTransferQueueFamilyIndex;
+				barrier.dstQueueFamilyIndex = myQueueFamilyIndex;
+				myAcquireBufferBarriers.push_back(barrier);
+				myAcquireBufferBarriers.back().srcAccessMask = 0;
+				barrier.dstAccessMask = 0;
+			}
+
+			for (auto& barrier : batch.imageBarriers)
+			{
+				barrier.srcQueueFamilyIndex = myTransferQueueFamilyIndex;
+				barrier.dstQueueFamilyIndex = myQueueFamilyIndex;
+				myAcquireImageBarriers.push_back(barrier);
+				myAcquireImageBarriers.back().srcAccessMask = 0;
+				barrier.dstAccessMask = 0;
+			}
+		}
+
+		if (!batch.bufferBarriers.empty() || !batch.imageBarriers.empty())
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				ownershipTransfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : uploadReadStages, 0, 0, nullptr,
+				static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(),
+				static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+
+		batch.bufferBarriers.clear();
+		batch.imageBarriers.clear();
+
+		CHECK_VK(vkEndCommandBuffer(batch.commandBuffer));
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+		if (queue != myQueue)
+		{
+			// one transfer batch per frame, submitted from beginFrame() after the frame's fence was waited
+			assert(myFrameUploadSemaphore == VK_NULL_HANDLE);
+
+			myFrameUploadSemaphore = myUploadCompleteSemaphores[myWindowData->FrameIndex];
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &myFrameUploadSemaphore;
+		}
+
+		CHECK_VK(vkQueueSubmit(queue, 1, &submitInfo, batch.fence));
+
+		mySubmittedUploadBatches.emplace_back(std::move(batch));
 	}
 
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const
+	// ownership acquires for the resources released by transfer queue batches, ahead of the frame's reads
+	void acquireUploadedResources(VkCommandBuffer cmd)
 	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		if (myAcquireBufferBarriers.empty() && myAcquireImageBarriers.empty())
+			return;
+
+		// the source stages match the frame's semaphore wait, which orders the acquire after the release
+		constexpr VkPipelineStageFlags uploadReadStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 
+		vkCmdPipelineBarrier(cmd, uploadReadStages, uploadReadStages, 0, 0, nullptr,
+			static_cast<uint32_t>(myAcquireBufferBarriers.size()), myAcquireBufferBarriers.data(),
+			static_cast<uint32_t>(myAcquireImageBarriers.size()), myAcquireImageBarriers.data());
+
+		myAcquireBufferBarriers.clear();
+		myAcquireImageBarriers.clear();
+	}
+
+	bool isUploadBatchDone(const UploadBatch& batch) const
+	{
+		VkResult result = myDeviceTable.vkGetFenceStatus(myDevice, batch.fence);
+		if (result != VK_NOT_READY)
+			CHECK_VK(result);
+
+		return result == VK_SUCCESS;
+	}
+
+	// waits for every submitted batch, only needed when the cpu has to see the result
+	void waitUploadBatches()
+	{
+		std::vector<VkFence> fences;
+		fences.reserve(mySubmittedUploadBatches.size());
+		for (const auto& batch : mySubmittedUploadBatches)
+			fences.push_back(batch.fence);
+
+		if (!fences.empty())
+			CHECK_VK(myDeviceTable.vkWaitForFences(myDevice, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX));
+
+		releaseUploadBatches();
+	}
+
+	// polls the submitted batches, and recycles the finished ones after releasing what they kept alive
+	void releaseUploadBatches()
+	{
+		for (auto batchIt = mySubmittedUploadBatches.begin(); batchIt != mySubmittedUploadBatches.end();)
+		{
+			if (!isUploadBatchDone(*batchIt))
+			{
+				++batchIt;
+				continue;
+			}
+
+			for (auto& destroyFunction : batchIt->destroyFunctions)
+				destroyFunction();
+
+			batchIt->destroyFunctions.clear();
+
+			myFreeUploadBatches[batchIt->queue].emplace_back(std::move(*batchIt));
+			batchIt = mySubmittedUploadBatches.erase(batchIt);
+		}
+	}
+
+	void cleanupUploadResources()
+	{
+		waitUploadBatches();
+
+		for (uint32_t queueIt = 0; queueIt < UploadQueue::Count; queueIt++)
+		{
+			for (const auto& batch : myFreeUploadBatches[queueIt])
+				vkDestroyFence(myDevice, batch.fence, nullptr);
+
+			myFreeUploadBatches[queueIt].clear();
+
+			vkDestroyCommandPool(myDevice, myUploadCommandPools[queueIt], nullptr);
+		}
+
+		for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
+			vkDestroySemaphore(myDevice, myUploadCompleteSemaphores[frameIt], nullptr);
+	}
+
+	void copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset, VkBuffer dstBuffer, VkDeviceSize size) const
+	{
 		VkBufferCopy copyRegion = {};
-		copyRegion.srcOffset = 0;
+		copyRegion.srcOffset = srcOffset;
 		copyRegion.dstOffset = 0;
 		copyRegion.size = size;
 		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-		endSingleTimeCommands(commandBuffer);
 	}
 
+	// outMappedData, if given, receives a pointer to the buffer memory that stays mapped for the buffer's lifetime
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags flags,
-		VkBuffer& outBuffer, VmaAllocation& outBufferMemory, const char* debugName) const
+		VkBuffer& outBuffer, VmaAllocation& outBufferMemory, const char* debugName, void** outMappedData = nullptr) const
 	{
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1270,53 +2776,54 @@ private:
 
 		VmaAllocationCreateInfo allocInfo = {};
 		allocInfo.flags = VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+		if (outMappedData)
+			allocInfo.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
 		allocInfo.usage = (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? VMA_MEMORY_USAGE_GPU_ONLY
 			: VMA_MEMORY_USAGE_UNKNOWN;
 		allocInfo.requiredFlags = flags;
 		allocInfo.memoryTypeBits = 0; // memRequirements.memoryTypeBits;
 		allocInfo.pUserData = (void*)debugName;
 
+		VmaAllocationInfo outAllocInfo = {};
 		CHECK_VK(vmaCreateBuffer(myAllocator, &bufferInfo, &allocInfo, &outBuffer, &outBufferMemory,
-			nullptr));
+			&outAllocInfo));
+
+		if (outMappedData)
+			*outMappedData = outAllocInfo.pMappedData;
 	}
 
 	template <typename T>
-	void createDeviceLocalBuffer(const T* bufferData, uint32_t bufferElementCount,
+	void createDeviceLocalBuffer(UploadBatch& batch, const T* bufferData, uint32_t bufferElementCount,
 		VkBufferUsageFlags usage, VkBuffer& outBuffer,
-		VmaAllocation& outBufferMemory, const char* debugName) const
+		VmaAllocation& outBufferMemory, const char* debugName)
 	{
 		assert(bufferData != nullptr);
 		assert(bufferElementCount > 0);
 		size_t bufferSize = sizeof(T) * bufferElementCount;
 
-		// todo: use staging buffer pool, or use scratchpad memory
 		VkBuffer stagingBuffer;
-		VmaAllocation stagingBufferMemory;
-		char buf[64];
-		strcpy(buf, debugName);
-		strcat(buf, "_staging");
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer, stagingBufferMemory, buf);
-
-		void* data;
-		CHECK_VK(vmaMapMemory(myAllocator, stagingBufferMemory, &data));
-		memcpy(data, bufferData, bufferSize);
-		vmaUnmapMemory(myAllocator, stagingBufferMemory);
+		VkDeviceSize stagingOffset;
+		memcpy(allocateStaging(batch, bufferSize, stagingBuffer, stagingOffset, debugName), bufferData, bufferSize);
 
 		createBuffer(bufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, outBuffer, outBufferMemory, debugName);
 
-		copyBuffer(stagingBuffer, outBuffer, bufferSize);
+		copyBuffer(batch.commandBuffer, stagingBuffer, stagingOffset, outBuffer, bufferSize);
 
-		vmaDestroyBuffer(myAllocator, stagingBuffer, stagingBufferMemory);
+		VkBufferMemoryBarrier barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = outBuffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		batch.bufferBarriers.push_back(barrier);
 	}
 
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
+	void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout,
 		VkImageLayout newLayout) const
 	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
 		VkImageMemoryBarrier barrier = {};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.oldLayout = oldLayout;
@@ -1382,16 +2889,12 @@ private:
 
 		vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0,
 			nullptr, 1, &barrier);
-
-		endSingleTimeCommands(commandBuffer);
 	}
 
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) const
+	void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height) const
 	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
 		VkBufferImageCopy region = {};
-		region.bufferOffset = 0;
+		region.bufferOffset = bufferOffset;
 		region.bufferRowLength = 0;
 		region.bufferImageHeight = 0;
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1403,8 +2906,6 @@ private:
 
 		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1, &region);
-
-		endSingleTimeCommands(commandBuffer);
 	}
 
 	void createImage2D(uint32_t width, uint32_t height, VkFormat format,
@@ -1442,38 +2943,34 @@ private:
 	}
 
 	template <typename T>
-	void createDeviceLocalImage2D(const T* imageData, uint32_t width, uint32_t height,
+	void createDeviceLocalImage2D(UploadBatch& batch, const T* imageData, uint32_t width, uint32_t height,
 		VkFormat format, VkImageUsageFlags usage,
-		VkImage& outImage, VmaAllocation& outImageMemory, const char* debugName) const
+		VkImage& outImage, VmaAllocation& outImageMemory, const char* debugName)
 	{
 		uint32_t pixelSizeBytes = getFormatSize(format); // todo
 		VkDeviceSize imageSize = width * height * pixelSizeBytes;
 
 		VkBuffer stagingBuffer;
-		VmaAllocation stagingBufferMemory;
-		char buf[64];
-		strcpy(buf, debugName);
-		strcat(buf, "_staging");
-		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer, stagingBufferMemory, buf);
-
-		void* data;
-		CHECK_VK(vmaMapMemory(myAllocator, stagingBufferMemory, &data));
-		memcpy(data, imageData, imageSize);
-		vmaUnmapMemory(myAllocator, stagingBufferMemory);
+		VkDeviceSize stagingOffset;
+		memcpy(allocateStaging(batch, imageSize, stagingBuffer, stagingOffset, debugName), imageData, imageSize);
 
 		createImage2D(width, height, format, VK_IMAGE_TILING_OPTIMAL, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, outImage, outImageMemory, debugName);
 
-		transitionImageLayout(outImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED,
+		transitionImageLayout(batch.commandBuffer, outImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		copyBufferToImage(stagingBuffer, outImage, width, height);
-		transitionImageLayout(outImage, VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		copyBufferToImage(batch.commandBuffer, stagingBuffer, stagingOffset, outImage, width, height);
 
-		vmaDestroyBuffer(myAllocator, stagingBuffer, stagingBufferMemory);
+		VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = outImage;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		batch.imageBarriers.push_back(barrier);
 	}
 
 	VkImageView createImageView2D(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) const
@@ -1508,7 +3005,7 @@ private:
 		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.anisotropyEnable = VK_TRUE;
+		samplerInfo.anisotropyEnable = myPhysicalDeviceFeatures.samplerAnisotropy;
 		samplerInfo.maxAnisotropy = 16;
 		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
 		samplerInfo.unnormalizedCoordinates = VK_FALSE;
@@ -1581,13 +3078,85 @@ private:
 
 		// Upload Fonts
 		{
-			VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-			ImGui_ImplVulkan_CreateFontsTexture(commandBuffer);
-			endSingleTimeCommands(commandBuffer);
+			UploadBatch batch = beginUploadBatch(UploadQueue::Graphics);
+			ImGui_ImplVulkan_CreateFontsTexture(batch.commandBuffer);
+			submitUploadBatch(std::move(batch));
+			waitUploadBatches(); // the font staging buffer is owned by imgui
 			ImGui_ImplVulkan_InvalidateFontUploadObjects();
 		}
 	}
 
+	// Everything that depends on myCommandBufferThreadCount, and not on the swapchain: the job system,
+	// the thread pools and the secondaries of each segment.
+	void createThreadResources()
+	{
+		// one worker per secondary command buffer, the primary is recorded on the calling thread
+		uint32_t workerCount = myCommandBufferThreadCount - 1;
+		if (!myJobSystem || myJobSystem->getThreadCount() != workerCount)
+			myJobSystem = std::make_unique<JobSystem>(workerCount);
+
+		myThreadCommandPools = std::vector<ThreadCommandPool>(myFrameCount * myCommandBufferThreadCount);
+		mySegmentCommandPools.resize(myFrameCount * getSegmentCount());
+		mySegmentCommandBuffers.assign(myFrameCount * getSegmentCount(), VK_NULL_HANDLE);
+		myCachedCommandBuffers.assign(myFrameCount * getSegmentCount(), VK_NULL_HANDLE);
+		mySegmentKeys.assign(myFrameCount * getSegmentCount(), 0);
+		mySegmentDrawLists.resize(getSegmentCount());
+
+		// frame pools are reset as a whole, so their buffers don't need to be resettable one by one
+		VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		cmdPoolInfo.queueFamilyIndex = myQueueFamilyIndex;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		for (auto& threadPool : myThreadCommandPools)
+			CHECK_VK(vkCreateCommandPool(myDevice, &cmdPoolInfo, nullptr, &threadPool.pool));
+
+		// cached secondaries outlive their frame and are reset one at a time
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		for (auto& pool : mySegmentCommandPools)
+			CHECK_VK(vkCreateCommandPool(myDevice, &cmdPoolInfo, nullptr, &pool));
+	}
+
+	// frees the command buffers along with the pools
+	void cleanupThreadResources()
+	{
+		for (auto& threadPool : myThreadCommandPools)
+			vkDestroyCommandPool(myDevice, threadPool.pool, nullptr);
+
+		for (auto& pool : mySegmentCommandPools)
+			vkDestroyCommandPool(myDevice, pool, nullptr);
+	}
+
+	// Switches to myRequestedCommandBufferThreadCount between two frames without waiting for the device.
+	// Frames in flight may still execute buffers of the old pools, so each frame's old pools are handed
+	// to its deletion queue, which runs once beginFrame() has waited for the frame's fence.
+	void recreateThreadResources()
+	{
+		uint32_t oldSegmentCount = getSegmentCount();
+
+		for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
+		{
+			std::vector<VkCommandPool> retiredPools;
+			retiredPools.reserve(myCommandBufferThreadCount + oldSegmentCount);
+
+			for (uint32_t threadIt = 0; threadIt < myCommandBufferThreadCount; threadIt++)
+				retiredPools.push_back(myThreadCommandPools[frameIt * myCommandBufferThreadCount + threadIt].pool);
+
+			for (uint32_t segmentIt = 0; segmentIt < oldSegmentCount; segmentIt++)
+				retiredPools.push_back(mySegmentCommandPools[frameIt * oldSegmentCount + segmentIt]);
+
+			myFrameDeletionQueues[frameIt].emplace_back([this, retiredPools = std::move(retiredPools)]
+			{
+				for (VkCommandPool pool : retiredPools)
+					vkDestroyCommandPool(myDevice, pool, nullptr);
+			});
+		}
+
+		myCommandBufferThreadCount = myRequestedCommandBufferThreadCount;
+
+		createThreadResources();
+	}
+
 	void createFrameResources(int width, int height)
 	{
 		myWindowData = std::make_unique<ImGui_ImplVulkanH_WindowData>(myFrameCount);
@@ -1622,301 +3191,892 @@ private:
 			myDepthImageMemory,
 			"myDepthImage");
 
-		myDepthImageView = createImageView2D(myDepthImage, myDepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+		myDepthImageView = createImageView2D(myDepthImage, myDepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+		myPrimaryCommandPools.resize(myFrameCount);
+
+		createThreadResources();
+
+		// Create SwapChain, RenderPass, Framebuffer, etc.
+		if (myHeadlessFlag)
+		{
+			myWindowData->Width = width;
+			myWindowData->Height = height;
+		}
+		else
+		{
+			ImGui_ImplVulkanH_CreateWindowDataSwapChainAndFramebuffer(
+				myPhysicalDevice, myDevice, myWindowData.get(), nullptr, width, height, true, myDepthImageView, myDepthFormat);
+		}
+
+		// frame pools are reset as a whole, so their buffers don't need to be resettable one by one
+		VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		cmdPoolInfo.queueFamilyIndex = myQueueFamilyIndex;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		for (auto& pool : myPrimaryCommandPools)
+			CHECK_VK(vkCreateCommandPool(myDevice, &cmdPoolInfo, nullptr, &pool));
+
+		myFrameFences.resize(myFrameCount);
+		myImageAcquiredSemaphores.resize(myFrameCount);
+		myRenderCompleteSemaphores.resize(myFrameCount);
+
+		for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
+		{
+			VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+			CHECK_VK(vkCreateFence(myDevice, &fenceInfo, nullptr, &myFrameFences[frameIt]));
+
+			VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+			CHECK_VK(vkCreateSemaphore(myDevice, &semaphoreInfo, nullptr, &myImageAcquiredSemaphores[frameIt]));
+			CHECK_VK(vkCreateSemaphore(myDevice, &semaphoreInfo, nullptr, &myRenderCompleteSemaphores[frameIt]));
+
+			VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			cmdInfo.commandPool = myPrimaryCommandPools[frameIt];
+			cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			cmdInfo.commandBufferCount = 1;
+
+			// IMGUI uses primary command buffer only
+			ImGui_ImplVulkanH_FrameData* fd = &myWindowData->Frames[frameIt];
+			fd->CommandPool = myPrimaryCommandPools[frameIt];
+			CHECK_VK(vkAllocateCommandBuffers(myDevice, &cmdInfo, &fd->CommandBuffer));
+			fd->Fence = myFrameFences[frameIt];
+			fd->ImageAcquiredSemaphore = myImageAcquiredSemaphores[frameIt];
+			fd->RenderCompleteSemaphore = myRenderCompleteSemaphores[frameIt];
+		}
+		//ImGui_ImplVulkanH_CreateWindowDataCommandBuffers(myDevice, myQueueFamilyIndex, myWindowData.get(), nullptr);
+
+		{
+			UploadBatch batch = beginUploadBatch(UploadQueue::Graphics);
+			transitionImageLayout(
+				batch.commandBuffer,
+				myDepthImage,
+				myDepthFormat,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+			submitUploadBatch(std::move(batch));
+		}
+
+		createRenderPass();
+
+		if (myHeadlessFlag)
+			createOffscreenFramebuffers(width, height);
+
+		createGraphicsPipelines();
+	}
+
+	void createOffscreenFramebuffers(int width, int height)
+	{
+		myOffscreenImages.resize(myFrameCount);
+		myOffscreenImageMemory.resize(myFrameCount);
+		myOffscreenImageViews.resize(myFrameCount);
+		myOffscreenFramebuffers.resize(myFrameCount);
+
+		for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
+		{
+			createImage2D(
+				width,
+				height,
+				mySurfaceFormat.format,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				myOffscreenImages[frameIt],
+				myOffscreenImageMemory[frameIt],
+				"myOffscreenImage");
+
+			myOffscreenImageViews[frameIt] = createImageView2D(
+				myOffscreenImages[frameIt], mySurfaceFormat.format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+			std::array<VkImageView, 2> attachments = { myOffscreenImageViews[frameIt], myDepthImageView };
+			VkFramebufferCreateInfo framebufferInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+			framebufferInfo.renderPass = myRenderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments = attachments.data();
+			framebufferInfo.width = width;
+			framebufferInfo.height = height;
+			framebufferInfo.layers = 1;
+			CHECK_VK(myDeviceTable.vkCreateFramebuffer(myDevice, &framebufferInfo, nullptr, &myOffscreenFramebuffers[frameIt]));
+		}
+	}
+
+	VkFramebuffer getFramebuffer(uint32_t frameIndex) const
+	{
+		return myHeadlessFlag ? myOffscreenFramebuffers[frameIndex] : myWindowData->Framebuffer[frameIndex];
+	}
+
+	void checkFlipOrPresentResult(VkResult result)
+	{
+		if (result == VK_SUBOPTIMAL_KHR)
+			return; // not much we can do
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+			myCreateFrameResourcesFlag = true;
+		else if (result != VK_SUCCESS)
+			throw std::runtime_error("failed to flip swap chain image!");
+	}
+
+	// everything but the phase of each instance is the same for the whole frame
+	static InstanceAnimation getAnimation(float time, float aspect, const glm::mat4& dequantize)
+	{
+		constexpr float period = 10.0;
+
+		InstanceAnimation animation;
+		animation.time = time;
+		animation.period = period;
+		animation.phaseStep = 0.0025f;
+		animation.depth = -0.01f - std::numeric_limits<float>::epsilon();
+
+		glm::mat4 view0 = glm::mat4(1);
+		glm::mat4 proj0 = glm::frustum(-1.0, 1.0, -1.0, 1.0, 0.01, 10.0);
+
+		glm::mat4 view1 = 
+			glm::lookAt(
+				glm::vec3(1.5f, 1.5f, 1.0f),
+				glm::vec3(0.0f, 0.0f, -0.5f),
+				glm::vec3(0.0f, 0.0f, -1.0f));
+		glm::mat4 proj1 = 
+			glm::perspective(
+				glm::radians(75.0f),
+				aspect,
+				0.01f,
+				10.0f);
+
+		std::copy_n(glm::value_ptr(view0), 16, animation.view0);
+		std::copy_n(glm::value_ptr(view1), 16, animation.view1);
+		std::copy_n(glm::value_ptr(proj0), 16, animation.proj0);
+		std::copy_n(glm::value_ptr(proj1), 16, animation.proj1);
+		std::copy_n(glm::value_ptr(dequantize), 16, animation.dequantize);
+
+		return animation;
+	}
+
+	// headless runs use a fixed time step so that every run animates (and renders) the same frames
+	inline float getAnimationTime(uint64_t frameNumber) const
+	{
+		constexpr float headlessTimeStep = 1.0f / 60.0f;
+
+		return myHeadlessFlag ? frameNumber * headlessTimeStep
+			: std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - myStartTime).count();
+	}
+
+	// Sets up the animation of the frame, after beginFrame() has waited for the frame's partitions and
+	// replaced any reloaded model. A frame packet is only used if it was simulated with the same
+	// animation, it goes stale if the model or the window changed after it was made.
+	void beginUniformUpdate()
+	{
+		float aspect = myWindowData->Width / static_cast<float>(myWindowData->Height);
+		float time = myFramePacket ? myFramePacket->animation.time : getAnimationTime(myFrameNumber);
+
+		myFrameAnimation = getAnimation(time, aspect, myHouseModel.myDequantizeTransform);
+
+		myFramePacketValidFlag = myFramePacket &&
+			std::memcmp(&myFramePacket->animation, &myFrameAnimation, sizeof(InstanceAnimation)) == 0;
+
+		if (mySimulationThread.joinable())
+		{
+			std::lock_guard<std::mutex> lock(mySimulationInputMutex);
+			mySimulationInput.aspect = aspect;
+			mySimulationInput.dequantize = myHouseModel.myDequantizeTransform;
+		}
+
+		if (isGpuCullingEnabled())
+		{
+			VkDeviceSize frameOffset = myWindowData->FrameIndex * myCullInputFrameSize;
+			writeCullInput(*reinterpret_cast<CullInput*>(myCullInputBufferData + frameOffset), myHouseModel);
+			vmaFlushAllocation(myAllocator, myCullInputBufferMemory, frameOffset, sizeof(CullInput));
+		}
+	}
+
+	// Updates instances [begin, end) of the frame, disjoint ranges may be updated from different threads.
+	void updateUniformBuffers(uint32_t begin, uint32_t end)
+	{
+		if (begin == end)
+			return;
+
+		static_assert(offsetof(UniformBufferObject, proj) == offsetof(InstanceUniforms, proj));
+		static_assert(sizeof(DrawTransform) == sizeof(InstanceDrawTransform));
+		static_assert(offsetof(DrawTransform, projectionScale) == offsetof(InstanceDrawTransform, projectionScale));
+
+		uint32_t frameIndex = myWindowData->FrameIndex;
+		char* data = myUniformBufferData + getUniformBufferOffset(frameIndex, 0);
+
+		// with gpu culling, the draw transforms go straight to the cull shader instead
+		char* cullInput = isGpuCullingEnabled() ? myCullInputBufferData + frameIndex * myCullInputFrameSize : nullptr;
+		InstanceDrawTransform* drawTransforms = cullInput ? reinterpret_cast<InstanceDrawTransform*>(cullInput + sizeof(CullInput))
+			: reinterpret_cast<InstanceDrawTransform*>(myDrawTransforms.data());
+		InstanceVertex* instances = myRenderOptions.instancedDraw ? &myInstanceBufferData[frameIndex * NX * NY] : nullptr;
+
+		if (myFramePacketValidFlag)
+		{
+			const FramePacket& packet = *myFramePacket;
+
+			for (uint32_t n = begin; n < end; n++)
+				std::memcpy(data + n * myUniformBufferStride, &packet.uniforms[n], sizeof(InstanceUniforms));
+
+			std::copy(packet.drawTransforms.data() + begin, packet.drawTransforms.data() + end, drawTransforms + begin);
+
+			if (instances)
+				for (uint32_t n = begin; n < end; n++)
+					std::copy_n(packet.instances[n].modelViewProj, 16, instances[n].modelViewProj);
+		}
+		else
+		{
+			updateInstanceTransforms(myFrameAnimation, begin, end, data, myUniformBufferStride, drawTransforms, instances);
+		}
+
+		// no-op on host coherent memory
+		vmaFlushAllocation(myAllocator, myUniformBufferMemory,
+			getUniformBufferOffset(frameIndex, begin), (end - begin) * myUniformBufferStride);
+
+		if (instances)
+			vmaFlushAllocation(myAllocator, myInstanceBufferMemory,
+				(frameIndex * NX * NY + begin) * sizeof(InstanceVertex), (end - begin) * sizeof(InstanceVertex));
+
+		if (cullInput)
+			vmaFlushAllocation(myAllocator, myCullInputBufferMemory,
+				frameIndex * myCullInputFrameSize + sizeof(CullInput) + begin * sizeof(InstanceDrawTransform),
+				(end - begin) * sizeof(InstanceDrawTransform));
+	}
+
+	inline bool isGpuCullingEnabled() const
+	{
+		return myRenderOptions.instancedDraw && myRenderOptions.gpuCulling;
+	}
+
+	void writeCullInput(CullInput& outInput, const Model& model) const
+	{
+		outInput.boundingSphere = model.myBoundingSphere;
+		outInput.instanceCount = NX * NY;
+		outInput.viewportCount = myInstancedViewportCount;
+		outInput.lodCount = std::min(static_cast<uint32_t>(model.myLods.size()), MeshLod::MaxCount);
+		outInput.maxPixelError = myRenderOptions.lodPixelError;
+		outInput.tileHalfHeight = 0.5f * (myWindowData->Height / NY);
+
+		for (uint32_t lodIt = 0; lodIt < outInput.lodCount; lodIt++)
+		{
+			const MeshLod& lod = model.myLods[lodIt];
+			outInput.lods[lodIt] = { lod.firstIndex, lod.indexCount, lod.error };
+		}
+	}
+
+	// Culls the instances of the frame and writes the indirect draws of drawInstanced(). Recorded into the
+	// primary command buffer ahead of the render pass, after the draws of the previous frame have read them.
+	void recordCulling(VkCommandBuffer cmd)
+	{
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = myDrawCommandBuffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		barrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		// zero commands are no-ops, so draws without a count can draw their whole range
+		vkCmdFillBuffer(cmd, myDrawCommandBuffer, 0, VK_WHOLE_SIZE, 0);
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		uint32_t cullInputOffset = static_cast<uint32_t>(myWindowData->FrameIndex * myCullInputFrameSize);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, myCullPipeline);
+		vkCmdBindDescriptorSets(
+			cmd,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			myCullPipelineLayout,
+			0,
+			1,
+			&myCullDescriptorSet,
+			1,
+			&cullInputOffset);
+
+		constexpr uint32_t groupSize = 64; // local_size_x of Cull.comp
+		vkCmdDispatch(cmd, (NX * NY + groupSize - 1) / groupSize, 1, 1);
+
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	void buildUI()
+	{
+		ImGui_ImplVulkan_NewFrame();
+		ImGui::NewFrame();
+
+		ImGui::ShowDemoWindow();
+
+		{
+			ImGui::Begin("Render Options");
+			ImGui::DragInt("Command Buffer Threads", &myRequestedCommandBufferThreadCount, 0.1f, 2, 32);
+			ImGui::ColorEdit3("Clear Color", &myWindowData->ClearValue.color.float32[0]);
+			if (myInstancedGraphicsPipelines.isValid())
+				ImGui::Checkbox("Instanced Draw", &myRequestedRenderOptions.instancedDraw);
+			if (myRequestedRenderOptions.instancedDraw && myGpuCullingSupported)
+				ImGui::Checkbox("GPU Culling", &myRequestedRenderOptions.gpuCulling);
+			if (!myRequestedRenderOptions.instancedDraw && myPushConstantGraphicsPipelines.isValid())
+				ImGui::Checkbox("Push Constants", &myRequestedRenderOptions.pushConstants);
+			if (!myRequestedRenderOptions.instancedDraw && myRequestedRenderOptions.pushConstants && myBindlessGraphicsPipelines.isValid())
+				ImGui::Checkbox("Bindless Textures", &myRequestedRenderOptions.bindlessTextures);
+			ImGui::Checkbox("Meshlet Culling", &myRequestedRenderOptions.meshletCulling);
+			if (myRenderOptions.meshletCulling && !myRenderOptions.instancedDraw)
+				ImGui::Text("Visible Meshlets: %u", myLastFrameStats.visibleMeshletCount);
+			ImGui::DragFloat("LOD Pixel Error", &myRequestedRenderOptions.lodPixelError, 0.05f, 0.0f, 16.0f);
+			ImGui::Checkbox("Pipelined Update", &myRequestedRenderOptions.pipelinedUpdate);
+			ImGui::Checkbox("Cache Command Buffers", &myRequestedRenderOptions.commandBufferCaching);
+			if (!isGpuCullingEnabled())
+				ImGui::Text("Triangles: %u", myLastFrameStats.drawnTriangleCount);
+			if (uint32_t pendingLoadCount = myPendingLoadCount.load())
+				ImGui::Text("Loading %u assets", pendingLoadCount);
+			ImGui::Text("Staging: %.1f / %.1f MB, peak %.1f MB",
+				myLastFrameStats.stagingUsedSize / (1024.0 * 1024.0),
+				myStagingRing->getCapacity() / (1024.0 * 1024.0),
+				myLastFrameStats.stagingHighWaterMark / (1024.0 * 1024.0));
+			ImGui::End();
+		}
+
+		{
+			ImGui::Begin("GUI Options");
+			static int styleIndex = 0;
+			ImGui::ShowStyleSelector("Styles", &styleIndex);
+			ImGui::ShowFontSelector("Fonts");
+			if (ImGui::Button("Show User Guide"))
+			{
+				ImGui::SetNextWindowPosCenter();
+				ImGui::OpenPopup("UserGuide");
+			}
+			if (ImGui::BeginPopup("UserGuide", ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove))
+			{
+				ImGui::ShowUserGuide();
+				ImGui::EndPopup();
+			}
+			ImGui::End();
+		}
+
+		{
+			ImGui::ShowMetricsWindow();
+		}
+
+		ImGui::Render();
+	}
+
+	// acquires the next frame, waits until the gpu is done with its previous use and starts its primary command buffer
+	void beginFrame()
+	{
+		ImGui_ImplVulkanH_FrameData* oldFrame = &myWindowData->Frames[myWindowData->FrameIndex];
+		myCurrentImageAcquiredSemaphore = oldFrame->ImageAcquiredSemaphore;
+
+		if (myHeadlessFlag)
+			myWindowData->FrameIndex = (myWindowData->FrameIndex + 1) % myFrameCount;
+		else
+			checkFlipOrPresentResult(myDeviceTable.vkAcquireNextImageKHR(myDevice, myWindowData->Swapchain,
+				UINT64_MAX, myCurrentImageAcquiredSemaphore,
+				VK_NULL_HANDLE, &myWindowData->FrameIndex));
+		/* MGPU method from vk 1.1 spec
+		{
+			VkAcquireNextImageInfoKHR nextImageInfo = {};
+			nextImageInfo.sType = VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR;
+			nextImageInfo.swapchain = myWindowData->Swapchain;
+			nextImageInfo.timeout = UINT64_MAX;
+			nextImageInfo.semaphore = imageAquiredSemaphore;
+			nextImageInfo.fence = VK_NULL_HANDLE;
+			nextImageInfo.deviceMask = ?;
+
+			checkFlipOrPresentResult(myDeviceTable.vkAcquireNextImage2KHR(myDevice, &nextImageInfo,
+		&myWindowData->FrameIndex));
+		}
+		 */
+
+		ImGui_ImplVulkanH_FrameData* newFrame = &myWindowData->Frames[myWindowData->FrameIndex];
+
+		// wait for previous command buffer to be submitted
+		{
+			CHECK_VK(myDeviceTable.vkWaitForFences(myDevice, 1, &newFrame->Fence, VK_TRUE, UINT64_MAX));
+			CHECK_VK(myDeviceTable.vkResetFences(myDevice, 1, &newFrame->Fence));
+		}
+
+		runDeferredDestroys(myWindowData->FrameIndex);
+		releaseUploadBatches();
+		myStagingRing->releaseFrame(myWindowData->FrameIndex); // covers the batches submitted ahead of the frame
+
+		// the gpu is done with everything recorded for the frame, but the cached secondaries
+		CHECK_VK(vkResetCommandPool(myDevice, newFrame->CommandPool, 0));
+
+		for (uint32_t threadIt = 0; threadIt < myCommandBufferThreadCount; threadIt++)
+		{
+			ThreadCommandPool& threadPool = myThreadCommandPools[myWindowData->FrameIndex * myCommandBufferThreadCount + threadIt];
+			CHECK_VK(vkResetCommandPool(myDevice, threadPool.pool, 0));
+			threadPool.usedCount = 0;
+		}
+
+		// begin primary command buffer
+		{
+			VkCommandBufferBeginInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VK(vkBeginCommandBuffer(newFrame->CommandBuffer, &info));
+		}
+
+		uploadLoadedAssets();
+		acquireUploadedResources(newFrame->CommandBuffer);
+	}
+
+	// Picks the lod of each instanced draw of model, the finest any of its tiles needs. With gpu
+	// culling the lods are picked on the gpu instead, and the draw list stays empty.
+	void gatherInstancedDraws(uint32_t dy, const Model& model, SegmentDrawList& outList)
+	{
+		constexpr uint32_t drawCount = NX * NY;
+
+		if (isGpuCullingEnabled())
+			return;
+
+		for (uint32_t firstInstance = 0; firstInstance < drawCount; firstInstance += myInstancedViewportCount)
+		{
+			uint32_t instanceCount = std::min(myInstancedViewportCount, drawCount - firstInstance);
+			uint32_t lodIndex = static_cast<uint32_t>(model.myLods.size()) - 1;
+
+			// the pipelines use all of their viewports, the ones past the last tile repeat it
+			for (uint32_t viewportIt = 0; viewportIt < myInstancedViewportCount; viewportIt++)
+			{
+				const DrawTransform& drawTransform = myDrawTransforms[std::min(firstInstance + viewportIt, drawCount - 1)];
+				lodIndex = std::min(lodIndex, getLod(
+					model,
+					drawTransform.cameraPosition,
+					0.5f * dy * drawTransform.projectionScale,
+					myRenderOptions.lodPixelError));
+			}
+
+			const MeshLod& lod = model.myLods[lodIndex];
+			outList.ranges.push_back({ lod.firstIndex, lod.indexCount });
+
+			myDrawnTriangleCount.fetch_add(instanceCount * (lod.indexCount / 3), std::memory_order_relaxed);
+		}
+
+		outList.key = hashData(outList.ranges.data(), outList.ranges.size() * sizeof(IndexRange), outList.key);
+	}
+
+	// Draws the NX * NY tiles of model with one instanced draw per myInstancedViewportCount tiles,
+	// every instance picks its tile's viewport. Draws use the lods of drawList, and meshlets aren't
+	// culled. With gpu culling, each draw is instead the indirect draws that recordCulling()
+	// compacted into its range of myDrawCommandBuffer, one per visible instance at its own lod.
+	void drawInstanced(VkCommandBuffer cmd, uint32_t dx, uint32_t dy, const Model& model, const SegmentDrawList& drawList)
+	{
+		constexpr uint32_t drawCount = NX * NY;
+
+		VkBuffer vertexBuffers[] = { model.myVertexBuffer, myInstanceBuffer };
+		VkDeviceSize vertexOffsets[] = { 0, myWindowData->FrameIndex * drawCount * sizeof(InstanceVertex) };
+
+		vkCmdBindVertexBuffers(cmd, 0, 2, vertexBuffers, vertexOffsets);
+		vkCmdBindIndexBuffer(cmd, model.myIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		// the instanced shaders don't read the uniform buffer, but the set still needs its dynamic offset
+		uint32_t uniformBufferOffset = getUniformBufferOffset(myWindowData->FrameIndex, 0);
+		vkCmdBindDescriptorSets(
+			cmd,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			myPipelineLayout,
+			0,
+			1,
+			&myDescriptorSet,
+			1,
+			&uniformBufferOffset);
+
+		std::array<VkViewport, drawCount> viewports;
+		std::array<VkRect2D, drawCount> scissors;
+
+		for (uint32_t firstInstance = 0, drawIt = 0; firstInstance < drawCount; firstInstance += myInstancedViewportCount, drawIt++)
+		{
+			uint32_t instanceCount = std::min(myInstancedViewportCount, drawCount - firstInstance);
+
+			for (uint32_t viewportIt = 0; viewportIt < myInstancedViewportCount; viewportIt++)
+			{
+				uint32_t n = std::min(firstInstance + viewportIt, drawCount - 1);
+				uint32_t i = n % NX;
+				uint32_t j = n / NX;
+
+				VkViewport& viewport = viewports[viewportIt];
+				viewport.x = static_cast<float>(i * dx);
+				viewport.y = static_cast<float>(j * dy);
+				viewport.width = static_cast<float>(dx);
+				viewport.height = static_cast<float>(dy);
+				viewport.minDepth = 0.0f;
+				viewport.maxDepth = 1.0f;
+
+				VkRect2D& scissor = scissors[viewportIt];
+				scissor.offset = { static_cast<int32_t>(i * dx), static_cast<int32_t>(j * dy) };
+				scissor.extent = { dx, dy };
+			}
+
+			vkCmdBindPipeline(
+				cmd,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				myInstancedGraphicsPipelines.data[drawIt & 1]);
+
+			vkCmdSetViewport(cmd, 0, myInstancedViewportCount, viewports.data());
+			vkCmdSetScissor(cmd, 0, myInstancedViewportCount, scissors.data());
+
+			if (isGpuCullingEnabled())
+			{
+				// the triangle count is only known on the gpu
+				constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+				VkDeviceSize commandOffset = firstInstance * stride;
+
+				if (myDrawIndirectCountSupported)
+					myDeviceTable.vkCmdDrawIndexedIndirectCountKHR(cmd, myDrawCommandBuffer, commandOffset,
+						myDrawCommandBuffer, myDrawCountOffset + drawIt * sizeof(uint32_t), instanceCount, stride);
+				else if (myPhysicalDeviceFeatures.multiDrawIndirect)
+					vkCmdDrawIndexedIndirect(cmd, myDrawCommandBuffer, commandOffset, instanceCount, stride);
+				else
+					for (uint32_t instanceIt = 0; instanceIt < instanceCount; instanceIt++)
+						vkCmdDrawIndexedIndirect(cmd, myDrawCommandBuffer, commandOffset + instanceIt * stride, 1, stride);
+
+				continue;
+			}
+
+			const IndexRange& range = drawList.ranges[drawIt];
+			vkCmdDrawIndexed(cmd, range.indexCount, instanceCount, range.firstIndex, 0, firstInstance);
+		}
+	}
+
+	// hands out the next secondary of the frame's pool of the calling thread, allocating one if all are in use
+	VkCommandBuffer allocateSecondaryCommandBuffer()
+	{
+		uint32_t threadIndex = myJobSystem->getCurrentThreadIndex();
+		ThreadCommandPool& threadPool = myThreadCommandPools[myWindowData->FrameIndex * myCommandBufferThreadCount + threadIndex];
+
+		if (threadPool.usedCount == threadPool.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			cmdInfo.commandPool = threadPool.pool;
+			cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			cmdInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			CHECK_VK(vkAllocateCommandBuffers(myDevice, &cmdInfo, &commandBuffer));
+			threadPool.commandBuffers.push_back(commandBuffer);
+		}
+
+		return threadPool.commandBuffers[threadPool.usedCount++];
+	}
+
+	// the tiles are split into segments of consecutive draws, one secondary command buffer each
+	inline uint32_t getSegmentCount() const
+	{
+		return std::max(myCommandBufferThreadCount - 1u, 1u);
+	}
+
+	inline uint32_t getSegmentDrawCount() const
+	{
+		return (NX * NY + getSegmentCount() - 1) / getSegmentCount();
+	}
+
+	// Culls and picks the lods of the tiles of segmentIt. Runs of visible meshlets are consecutive
+	// index ranges, so each run is merged into one range.
+	void gatherSegmentDraws(uint32_t segmentIt, uint32_t dx, uint32_t dy, const Model& model, SegmentDrawList& outList)
+	{
+		constexpr uint32_t drawCount = NX * NY;
+		uint32_t segmentDrawCount = getSegmentDrawCount();
+
+		auto hash = [&outList](const auto& value)
+		{
+			outList.key = hashData(&value, sizeof(value), outList.key);
+		};
+
+		for (uint32_t drawIt = 0; drawIt < segmentDrawCount; drawIt++)
+		{
+			uint32_t n = segmentIt * segmentDrawCount + drawIt;
+
+			if (n >= drawCount)
+				break;
+
+			uint32_t i = n % NX;
+			uint32_t j = n / NX;
+
+			const DrawTransform& drawTransform = myDrawTransforms[n];
+
+			TileDraw draw = {};
+			draw.rect.offset = { static_cast<int32_t>(i * dx), static_cast<int32_t>(j * dy) };
+			draw.rect.extent = { dx, dy };
+			draw.firstRange = static_cast<uint32_t>(outList.ranges.size());
+
+			hash(draw.rect);
+
+			if (myRenderOptions.pushConstants)
+			{
+				draw.pushConstants.modelViewProj = drawTransform.modelViewProj * model.myDequantizeTransform;
+				draw.pushConstants.textureIndex = myHouseImage.myTableIndex;
+
+				hash(draw.pushConstants.modelViewProj);
+				hash(draw.pushConstants.textureIndex);
+			}
+			else
+			{
+				draw.uniformBufferOffset = getUniformBufferOffset(myWindowData->FrameIndex, n);
+
+				hash(draw.uniformBufferOffset);
+			}
 
-		myCommandPools.resize(myCommandBufferThreadCount);
-		myCommandBuffers.resize(myCommandBufferThreadCount * myFrameCount);
+			const MeshLod& lod = model.myLods[getLod(
+				model,
+				drawTransform.cameraPosition,
+				0.5f * dy * drawTransform.projectionScale,
+				myRenderOptions.lodPixelError)];
 
-		// Create SwapChain, RenderPass, Framebuffer, etc.
-		ImGui_ImplVulkanH_CreateWindowDataSwapChainAndFramebuffer(
-			myPhysicalDevice, myDevice, myWindowData.get(), nullptr, width, height, true, myDepthImageView, myDepthFormat);
+			if (!myRenderOptions.meshletCulling || lod.meshletCount == 0)
+			{
+				outList.ranges.push_back({ lod.firstIndex, lod.indexCount });
+				myDrawnTriangleCount.fetch_add(lod.indexCount / 3, std::memory_order_relaxed);
+			}
+			else
+			{
+				glm::vec4 frustumPlanes[6];
+				getFrustumPlanes(drawTransform.modelViewProj, frustumPlanes);
 
-		std::vector<VkCommandBuffer> threadCommandBuffers(myFrameCount);
-		for (uint32_t cmdIt = 0; cmdIt < myCommandBufferThreadCount; cmdIt++)
-		{
-			VkCommandPoolCreateInfo cmdPoolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
-			cmdPoolInfo.queueFamilyIndex = myQueueFamilyIndex;
-			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-			CHECK_VK(vkCreateCommandPool(myDevice, &cmdPoolInfo, nullptr, &myCommandPools[cmdIt]));
-			assert(myCommandPools[cmdIt] != VK_NULL_HANDLE);
+				IndexRange range = {};
+				uint32_t visibleMeshletCount = 0;
+				uint32_t triangleCount = 0;
 
-			VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-			cmdInfo.commandPool = myCommandPools[cmdIt];
-			cmdInfo.level = cmdIt == 0 ? VK_COMMAND_BUFFER_LEVEL_PRIMARY : VK_COMMAND_BUFFER_LEVEL_SECONDARY;
-			cmdInfo.commandBufferCount = myFrameCount;
-			CHECK_VK(vkAllocateCommandBuffers(myDevice, &cmdInfo, threadCommandBuffers.data()));
+				for (uint32_t meshletIt = 0; meshletIt < lod.meshletCount; meshletIt++)
+				{
+					const Meshlet& meshlet = model.myMeshlets[lod.firstMeshlet + meshletIt];
 
-			for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
-				myCommandBuffers[myCommandBufferThreadCount * frameIt + cmdIt] = threadCommandBuffers[frameIt];
-		}
+					if (!isMeshletVisible(meshlet, frustumPlanes, drawTransform.cameraPosition))
+						continue;
 
-		myFrameFences.resize(myFrameCount);
-		myImageAcquiredSemaphores.resize(myFrameCount);
-		myRenderCompleteSemaphores.resize(myFrameCount);
+					visibleMeshletCount++;
+					triangleCount += meshlet.indexCount / 3;
 
-		for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
-		{
-			VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-			CHECK_VK(vkCreateFence(myDevice, &fenceInfo, nullptr, &myFrameFences[frameIt]));
+					if (range.firstIndex + range.indexCount == meshlet.firstIndex)
+					{
+						range.indexCount += meshlet.indexCount;
+						continue;
+					}
 
-			VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-			CHECK_VK(vkCreateSemaphore(myDevice, &semaphoreInfo, nullptr, &myImageAcquiredSemaphores[frameIt]));
-			CHECK_VK(vkCreateSemaphore(myDevice, &semaphoreInfo, nullptr, &myRenderCompleteSemaphores[frameIt]));
+					if (range.indexCount > 0)
+						outList.ranges.push_back(range);
 
-			// IMGUI uses primary command buffer only
-			ImGui_ImplVulkanH_FrameData* fd = &myWindowData->Frames[frameIt];
-			fd->CommandPool = myCommandPools[0];
-			fd->CommandBuffer = myCommandBuffers[myCommandBufferThreadCount * frameIt];
-			fd->Fence = myFrameFences[frameIt];
-			fd->ImageAcquiredSemaphore = myImageAcquiredSemaphores[frameIt];
-			fd->RenderCompleteSemaphore = myRenderCompleteSemaphores[frameIt];
-		}
-		//ImGui_ImplVulkanH_CreateWindowDataCommandBuffers(myDevice, myQueueFamilyIndex, myWindowData.get(), nullptr);
+					range = { meshlet.firstIndex, meshlet.indexCount };
+				}
 
-		transitionImageLayout(
-			myDepthImage,
-			myDepthFormat,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+				if (range.indexCount > 0)
+					outList.ranges.push_back(range);
 
-		createRenderPass();
-		createGraphicsPipelines();
-	}
+				myVisibleMeshletCount.fetch_add(visibleMeshletCount, std::memory_order_relaxed);
+				myDrawnTriangleCount.fetch_add(triangleCount, std::memory_order_relaxed);
+			}
 
-	void checkFlipOrPresentResult(VkResult result)
-	{
-		if (result == VK_SUBOPTIMAL_KHR)
-			return; // not much we can do
-		if (result == VK_ERROR_OUT_OF_DATE_KHR)
-			myCreateFrameResourcesFlag = true;
-		else if (result != VK_SUCCESS)
-			throw std::runtime_error("failed to flip swap chain image!");
-	}
+			draw.rangeCount = static_cast<uint32_t>(outList.ranges.size()) - draw.firstRange;
 
-	void updateUniformBuffers()
-	{
-		UniformBufferObject* data;
-		CHECK_VK(vmaMapMemory(myAllocator, myUniformBufferMemory, (void**)&data));
+			hash(draw.rangeCount);
 
-		static auto start = std::chrono::high_resolution_clock::now();
-		auto now = std::chrono::high_resolution_clock::now();
-		constexpr float period = 10.0;
-		float t = std::chrono::duration<float>(now - start).count();
-
-		for (uint32_t n = 0; n < (NX * NY); n++)
-		{
-			UniformBufferObject& ubo = data[n];				
-
-			float tp = fmod((0.0025f * n) + t, period);
-			float s = smootherstep(
-				smoothstep(clamp(ramp(tp < (0.5f * period) ? tp : period - tp, 0, 0.5f * period), 0, 1)));
-
-			glm::mat4 model = glm::rotate(
-				glm::translate(
-					glm::mat4(1),
-					glm::vec3(0, 0, -0.01f - std::numeric_limits<float>::epsilon())),
-				s * glm::radians(360.0f),
-				glm::vec3(0.0, 0.0, 1.0));
-
-			glm::mat4 view0 = glm::mat4(1);
-			glm::mat4 proj0 = glm::frustum(-1.0, 1.0, -1.0, 1.0, 0.01, 10.0);
-
-			glm::mat4 view1 = 
-				glm::lookAt(
-					glm::vec3(1.5f, 1.5f, 1.0f),
-					glm::vec3(0.0f, 0.0f, -0.5f),
-					glm::vec3(0.0f, 0.0f, -1.0f));
-			glm::mat4 proj1 = 
-				glm::perspective(
-					glm::radians(75.0f),
-					myWindowData->Width / static_cast<float>(myWindowData->Height),
-					0.01f,
-					10.0f);
-
-			ubo.model = model;
-			ubo.view = glm::mat4(
-				lerp(view0[0], view1[0], s),
-				lerp(view0[1], view1[1], s),
-				lerp(view0[2], view1[2], s),
-				lerp(view0[3], view1[3], s));
-			ubo.proj = glm::mat4(
-				lerp(proj0[0], proj1[0], s),
-				lerp(proj0[1], proj1[1], s),
-				lerp(proj0[2], proj1[2], s),
-				lerp(proj0[3], proj1[3], s));
-
-			vmaFlushAllocation(
-				myAllocator,
-				myUniformBufferMemory,
-				n * sizeof(UniformBufferObject),
-				sizeof(UniformBufferObject));
+			outList.draws.push_back(draw);
 		}
-		
-		vmaUnmapMemory(myAllocator, myUniformBufferMemory);
+
+		outList.key = hashData(outList.ranges.data(), outList.ranges.size() * sizeof(IndexRange), outList.key);
 	}
 
-	void submitFrame()
+	// what a secondary command buffer is recorded with besides its draw list
+	uint64_t getSegmentStateKey(uint32_t dx, uint32_t dy, const GraphicsPipelines& pipelines, bool bindlessTextures) const
 	{
-		ImGui_ImplVulkanH_FrameData* oldFrame = &myWindowData->Frames[myWindowData->FrameIndex];
-		VkSemaphore& imageAquiredSemaphore = oldFrame->ImageAcquiredSemaphore;
-
-		checkFlipOrPresentResult(myDeviceTable.vkAcquireNextImageKHR(myDevice, myWindowData->Swapchain,
-			UINT64_MAX, imageAquiredSemaphore,
-			VK_NULL_HANDLE, &myWindowData->FrameIndex));
-		/* MGPU method from vk 1.1 spec
+		uint64_t key = 0;
+		auto hash = [&key](const auto& value)
 		{
-			VkAcquireNextImageInfoKHR nextImageInfo = {};
-			nextImageInfo.sType = VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR;
-			nextImageInfo.swapchain = myWindowData->Swapchain;
-			nextImageInfo.timeout = UINT64_MAX;
-			nextImageInfo.semaphore = imageAquiredSemaphore;
-			nextImageInfo.fence = VK_NULL_HANDLE;
-			nextImageInfo.deviceMask = ?;
+			key = hashData(&value, sizeof(value), key);
+		};
 
-			checkFlipOrPresentResult(myDeviceTable.vkAcquireNextImage2KHR(myDevice, &nextImageInfo,
-		&myWindowData->FrameIndex));
-		}
-		 */
+		hash(myResourceGeneration);
+		hash(getFramebuffer(myWindowData->FrameIndex));
+		hash(pipelines.data);
+		hash(myHouseModel.myVertexBuffer);
+		hash(myHouseModel.myIndexBuffer);
+		hash(myDescriptorSet);
+		hash(dx);
+		hash(dy);
+		hash(myRenderOptions.instancedDraw);
+		hash(myRenderOptions.gpuCulling);
+		hash(myRenderOptions.pushConstants);
+		hash(bindlessTextures);
+
+		return key;
+	}
 
-		ImGui_ImplVulkanH_FrameData* newFrame = &myWindowData->Frames[myWindowData->FrameIndex];
+	// Records the secondary command buffer of segmentIt, segments may be recorded from different threads.
+	// With command buffer caching, the one of the current swapchain image is kept as long as it would be
+	// recorded from the same state and draw list, and only its draw list is gathered.
+	void recordSegment(uint32_t segmentIt)
+	{
+		uint32_t dx = myWindowData->Width / NX;
+		uint32_t dy = myWindowData->Height / NY;
+
+		bool bindlessTextures = myRenderOptions.pushConstants && myRenderOptions.bindlessTextures && myTextureTableSet != VK_NULL_HANDLE;
+		const GraphicsPipelines& pipelines = myRenderOptions.instancedDraw ? myInstancedGraphicsPipelines
+			: !myRenderOptions.pushConstants ? myGraphicsPipelines
+			: bindlessTextures ? myBindlessGraphicsPipelines : myPushConstantGraphicsPipelines;
+
+		// culling and lod selection depend on the transforms, so the draw lists are gathered every frame
+		SegmentDrawList& drawList = mySegmentDrawLists[segmentIt];
+		drawList.draws.clear();
+		drawList.ranges.clear();
+		drawList.key = getSegmentStateKey(dx, dy, pipelines, bindlessTextures);
+
+		// the whole grid is a couple of draws, the other segments stay empty
+		if (!myRenderOptions.instancedDraw)
+			gatherSegmentDraws(segmentIt, dx, dy, myHouseModel, drawList);
+		else if (segmentIt == 0)
+			gatherInstancedDraws(dy, myHouseModel, drawList);
+
+		uint32_t segmentIndex = myWindowData->FrameIndex * getSegmentCount() + segmentIt;
+		VkCommandBuffer& cmd = mySegmentCommandBuffers[segmentIndex];
+
+		if (myRenderOptions.commandBufferCaching)
+		{
+			VkCommandBuffer& cachedCmd = myCachedCommandBuffers[segmentIndex];
+			uint64_t& cachedKey = mySegmentKeys[segmentIndex];
 
-		std::array<VkClearValue, 2> clearValues = {};
-		clearValues[0] = myWindowData->ClearValue;
-		clearValues[1].depthStencil = { 1.0f, 0 };
+			if (cachedCmd == VK_NULL_HANDLE)
+			{
+				VkCommandBufferAllocateInfo cmdInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+				cmdInfo.commandPool = mySegmentCommandPools[segmentIndex];
+				cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+				cmdInfo.commandBufferCount = 1;
+				CHECK_VK(vkAllocateCommandBuffers(myDevice, &cmdInfo, &cachedCmd));
+			}
+			else if (cachedKey == drawList.key)
+			{
+				cmd = cachedCmd;
+				return;
+			}
+			else
+			{
+				CHECK_VK(vkResetCommandBuffer(cachedCmd, 0));
+			}
 
-		// wait for previous command buffer to be submitted
+			cmd = cachedCmd;
+			cachedKey = drawList.key;
+		}
+		else
 		{
-			CHECK_VK(myDeviceTable.vkWaitForFences(myDevice, 1, &newFrame->Fence, VK_TRUE, UINT64_MAX));
-			CHECK_VK(myDeviceTable.vkResetFences(myDevice, 1, &newFrame->Fence));
+			cmd = allocateSecondaryCommandBuffer();
+			mySegmentKeys[segmentIndex] = 0;
 		}
 
-		// setup draw parameters
-		constexpr uint32_t drawCount = NX * NY;
-		uint32_t segmentCount = std::max(myCommandBufferThreadCount - 1u, 1u);
+		VkCommandBufferInheritanceInfo inherit = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+		inherit.renderPass = myRenderPass;
+		inherit.framebuffer = getFramebuffer(myWindowData->FrameIndex);
 
-		// begin secondary command buffers
-		for (uint32_t segmentIt = 0; segmentIt < segmentCount; segmentIt++)
+		VkCommandBufferBeginInfo secBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		secBeginInfo.flags =
+			VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+			VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		if (!myRenderOptions.commandBufferCaching)
+			secBeginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		secBeginInfo.pInheritanceInfo = &inherit;
+		CHECK_VK(vkBeginCommandBuffer(cmd, &secBeginInfo));
+
+		if (myRenderOptions.instancedDraw)
 		{
-			VkCommandBuffer& cmd =
-				myCommandBuffers[myWindowData->FrameIndex * myCommandBufferThreadCount + (segmentIt + 1)];
+			if (segmentIt == 0)
+				drawInstanced(cmd, dx, dy, myHouseModel, drawList);
 
-			VkCommandBufferInheritanceInfo inherit = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
-			inherit.renderPass = myRenderPass;
-			inherit.framebuffer = myWindowData->Framebuffer[myWindowData->FrameIndex];
+			CHECK_VK(vkEndCommandBuffer(cmd));
+			return;
+		}
 
-			CHECK_VK(vkResetCommandBuffer(cmd, 0));
-			VkCommandBufferBeginInfo secBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-			secBeginInfo.flags =
-				VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
-				VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
-				VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			secBeginInfo.pInheritanceInfo = &inherit;
-			CHECK_VK(vkBeginCommandBuffer(cmd, &secBeginInfo));
+		// bind pipeline and vertex/index buffers
+		vkCmdBindPipeline(
+			cmd,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelines.data[segmentIt & 1]);
 
-			// bind pipeline and vertex/index buffers
-			vkCmdBindPipeline(
+		VkBuffer vertexBuffers[] = { myHouseModel.myVertexBuffer };
+		VkDeviceSize vertexOffsets[] = { 0 };
+
+		vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, vertexOffsets);
+		vkCmdBindIndexBuffer(cmd, myHouseModel.myIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		// the push constant shaders don't read the uniform buffer, but the set still needs its dynamic offset
+		if (myRenderOptions.pushConstants)
+		{
+			VkDescriptorSet descriptorSets[] = { myDescriptorSet, myTextureTableSet };
+			uint32_t uniformBufferOffset = getUniformBufferOffset(myWindowData->FrameIndex, 0);
+			vkCmdBindDescriptorSets(
 				cmd,
 				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				myGraphicsPipelines.data[segmentIt & 1]);
-			
-			VkBuffer vertexBuffers[] = { myHouseModel.myVertexBuffer };
-			VkDeviceSize vertexOffsets[] = { 0 };
-
-			vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, vertexOffsets);
-			vkCmdBindIndexBuffer(cmd, myHouseModel.myIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+				myPushConstantPipelineLayout,
+				0,
+				bindlessTextures ? 2 : 1,
+				descriptorSets,
+				1,
+				&uniformBufferOffset);
 		}
 
-		// draw geometry using secondary command buffers
+		for (const TileDraw& draw : drawList.draws)
 		{
-			uint32_t segmentDrawCount = drawCount / segmentCount;
-			if (drawCount % segmentCount)
-				segmentDrawCount += 1;
-
-			uint32_t dx = myWindowData->Width / NX;
-			uint32_t dy = myWindowData->Height / NY;
-
-			std::array<uint32_t, 128> seq;
-			std::iota(seq.begin(), seq.begin() + segmentCount, 0);
-			std::for_each_n(
-			#if defined(__WINDOWS__)
-				std::execution::par,
-			#endif
-				seq.begin(),
-				segmentCount,
-				[this, &dx, &dy, &segmentDrawCount](uint32_t segmentIt)
+			VkViewport viewport = {};
+			viewport.x = static_cast<float>(draw.rect.offset.x);
+			viewport.y = static_cast<float>(draw.rect.offset.y);
+			viewport.width = static_cast<float>(draw.rect.extent.width);
+			viewport.height = static_cast<float>(draw.rect.extent.height);
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+
+			if (myRenderOptions.pushConstants)
 			{
-				VkCommandBuffer& cmd = myCommandBuffers[myWindowData->FrameIndex * myCommandBufferThreadCount + (segmentIt + 1)];
-
-				for (uint32_t drawIt = 0; drawIt < segmentDrawCount; drawIt++)
-				{
-					uint32_t n = segmentIt * segmentDrawCount + drawIt;
-
-					if (n >= drawCount)
-						break;
-
-					uint32_t i = n % NX;
-					uint32_t j = n / NX;
+				vkCmdPushConstants(
+					cmd,
+					myPushConstantPipelineLayout,
+					VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+					0,
+					sizeof(draw.pushConstants),
+					&draw.pushConstants);
+			}
+			else
+			{
+				vkCmdBindDescriptorSets(
+					cmd,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					myPipelineLayout,
+					0,
+					1,
+					&myDescriptorSet,
+					1,
+					&draw.uniformBufferOffset);
+			}
 
-					auto drawModel = [this, &n](VkCommandBuffer cmd, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t indexCount)
-					{
-						VkViewport viewport = {};
-						viewport.x = static_cast<float>(x);
-						viewport.y = static_cast<float>(y);
-						viewport.width = static_cast<float>(width);
-						viewport.height = static_cast<float>(height);
-						viewport.minDepth = 0.0f;
-						viewport.maxDepth = 1.0f;
-
-						VkRect2D scissor = {};
-						scissor.offset = { x, y };
-						scissor.extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
-
-						uint32_t uniformBufferOffset = n * sizeof(UniformBufferObject);
-						vkCmdBindDescriptorSets(
-							cmd,
-							VK_PIPELINE_BIND_POINT_GRAPHICS,
-							myPipelineLayout,
-							0,
-							1,
-							&myDescriptorSet,
-							1,
-							&uniformBufferOffset);
-
-						vkCmdSetViewport(cmd, 0, 1, &viewport);
-						vkCmdSetScissor(cmd, 0, 1, &scissor);
-						vkCmdDrawIndexed(cmd, indexCount, 1, 0, 0, 0);
-					};
+			vkCmdSetViewport(cmd, 0, 1, &viewport);
+			vkCmdSetScissor(cmd, 0, 1, &draw.rect);
 
-					drawModel(cmd, i * dx, j * dy, dx, dy, myHouseModel.indexCount);
-				}
-			});
+			for (uint32_t rangeIt = draw.firstRange; rangeIt < draw.firstRange + draw.rangeCount; rangeIt++)
+				vkCmdDrawIndexed(cmd, drawList.ranges[rangeIt].indexCount, 1, drawList.ranges[rangeIt].firstIndex, 0, 0);
 		}
 
-		// end secondary command buffers
-		for (uint32_t segmentIt = 0; segmentIt < segmentCount; segmentIt++)
-		{
-			VkCommandBuffer& cmd =
-				myCommandBuffers[myWindowData->FrameIndex * myCommandBufferThreadCount + (segmentIt + 1)];
+		CHECK_VK(vkEndCommandBuffer(cmd));
+	}
 
-			CHECK_VK(vkEndCommandBuffer(cmd));
-		}
+	// assembles the primary command buffer from the recorded segments and the ui, and submits it
+	void submitFrame()
+	{
+		ImGui_ImplVulkanH_FrameData* newFrame = &myWindowData->Frames[myWindowData->FrameIndex];
 
-		// begin primary command buffer
-		{
-			CHECK_VK(vkResetCommandBuffer(newFrame->CommandBuffer, 0));
-			VkCommandBufferBeginInfo info = {};
-			info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-			CHECK_VK(vkBeginCommandBuffer(newFrame->CommandBuffer, &info));
-		}
+		std::array<VkClearValue, 2> clearValues = {};
+		clearValues[0] = myWindowData->ClearValue;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		if (isGpuCullingEnabled())
+			recordCulling(newFrame->CommandBuffer);
 
 		// call secondary command buffers
 		{
 			VkRenderPassBeginInfo beginInfo = {};
 			beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 			beginInfo.renderPass = myRenderPass;
-			beginInfo.framebuffer = myWindowData->Framebuffer[myWindowData->FrameIndex];
+			beginInfo.framebuffer = getFramebuffer(myWindowData->FrameIndex);
 			beginInfo.renderArea.offset = { 0, 0 };
 			beginInfo.renderArea.extent = { static_cast<uint32_t>(myWindowData->Width), static_cast<uint32_t>(myWindowData->Height) };
 			beginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
@@ -1924,8 +4084,8 @@ private:
 			vkCmdBeginRenderPass(newFrame->CommandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
 			vkCmdExecuteCommands(newFrame->CommandBuffer,
-				(myCommandBufferThreadCount - 1),
-				&myCommandBuffers[(myWindowData->FrameIndex * myCommandBufferThreadCount) + 1]);
+				getSegmentCount(),
+				&mySegmentCommandBuffers[myWindowData->FrameIndex * getSegmentCount()]);
 
 			vkCmdEndRenderPass(newFrame->CommandBuffer);
 		}
@@ -1950,24 +4110,45 @@ private:
 
 		// Submit primary command buffer
 		{
-			VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			VkSemaphore waitSemaphores[2];
+			VkPipelineStageFlags waitStages[2];
+			uint32_t waitSemaphoreCount = 0;
+
+			if (!myHeadlessFlag)
+			{
+				waitSemaphores[waitSemaphoreCount] = myCurrentImageAcquiredSemaphore;
+				waitStages[waitSemaphoreCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			}
+
+			if (myFrameUploadSemaphore != VK_NULL_HANDLE)
+			{
+				waitSemaphores[waitSemaphoreCount] = myFrameUploadSemaphore;
+				waitStages[waitSemaphoreCount++] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+				myFrameUploadSemaphore = VK_NULL_HANDLE;
+			}
+
 			VkSubmitInfo submitInfo = {};
 			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-			submitInfo.waitSemaphoreCount = 1;
-			submitInfo.pWaitSemaphores = &imageAquiredSemaphore;
-			submitInfo.pWaitDstStageMask = &waitStage;
+			submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+			submitInfo.pWaitSemaphores = waitSemaphores;
+			submitInfo.pWaitDstStageMask = waitStages;
 			submitInfo.commandBufferCount = 1;
 			submitInfo.pCommandBuffers = &newFrame->CommandBuffer;
-			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.signalSemaphoreCount = myHeadlessFlag ? 0 : 1;
 			submitInfo.pSignalSemaphores = &newFrame->RenderCompleteSemaphore;
 
 			CHECK_VK(vkEndCommandBuffer(newFrame->CommandBuffer));
 			CHECK_VK(vkQueueSubmit(myQueue, 1, &submitInfo, newFrame->Fence));
 		}
+
+		myStagingRing->endFrame(myWindowData->FrameIndex);
 	}
 
 	void presentFrame()
 	{
+		if (myHeadlessFlag)
+			return;
+
 		ImGui_ImplVulkanH_FrameData* fd = &myWindowData->Frames[myWindowData->FrameIndex];
 		VkPresentInfoKHR info = {};
 		info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1990,38 +4171,75 @@ private:
 				vkDestroySemaphore(myDevice, myRenderCompleteSemaphores[frameIt], nullptr);
 			}
 
-			std::vector<VkCommandBuffer> threadCommandBuffers(myFrameCount);
-			for (uint32_t cmdIt = 0; cmdIt < myCommandBufferThreadCount; cmdIt++)
-			{
-				for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
-					threadCommandBuffers[frameIt] = myCommandBuffers[myCommandBufferThreadCount * frameIt + cmdIt];
+			// frees the command buffers along with the pools
+			for (auto& pool : myPrimaryCommandPools)
+				vkDestroyCommandPool(myDevice, pool, nullptr);
 
-				vkFreeCommandBuffers(myDevice, myCommandPools[cmdIt], myFrameCount, threadCommandBuffers.data());
-				vkDestroyCommandPool(myDevice, myCommandPools[cmdIt], nullptr);
-			}
+			cleanupThreadResources();
 		}
 
-		ImGui_ImplVulkanH_DestroyWindowDataSwapChainAndFramebuffer(myDevice, myWindowData.get(), nullptr);
+		if (myHeadlessFlag)
+		{
+			for (uint32_t frameIt = 0; frameIt < myOffscreenFramebuffers.size(); frameIt++)
+			{
+				myDeviceTable.vkDestroyFramebuffer(myDevice, myOffscreenFramebuffers[frameIt], nullptr);
+				myDeviceTable.vkDestroyImageView(myDevice, myOffscreenImageViews[frameIt], nullptr);
+				vmaDestroyImage(myAllocator, myOffscreenImages[frameIt], myOffscreenImageMemory[frameIt]);
+			}
+
+			myOffscreenFramebuffers.clear();
+			myOffscreenImageViews.clear();
+			myOffscreenImages.clear();
+			myOffscreenImageMemory.clear();
+		}
+		else
+		{
+			ImGui_ImplVulkanH_DestroyWindowDataSwapChainAndFramebuffer(myDevice, myWindowData.get(), nullptr);
+		}
 
 		vmaDestroyImage(myAllocator, myDepthImage, myDepthImageMemory);
 		myDeviceTable.vkDestroyImageView(myDevice, myDepthImageView, nullptr);
 
 		for (uint32_t pipelineIt = 0; pipelineIt < GraphicsPipelines::Count; pipelineIt++)
+		{
 			myDeviceTable.vkDestroyPipeline(myDevice, myGraphicsPipelines.data[pipelineIt], nullptr);
+			myDeviceTable.vkDestroyPipeline(myDevice, myInstancedGraphicsPipelines.data[pipelineIt], nullptr);
+			myDeviceTable.vkDestroyPipeline(myDevice, myPushConstantGraphicsPipelines.data[pipelineIt], nullptr);
+			myDeviceTable.vkDestroyPipeline(myDevice, myBindlessGraphicsPipelines.data[pipelineIt], nullptr);
+		}
+
+		// optional pipelines may not be created again
+		myGraphicsPipelines = {};
+		myInstancedGraphicsPipelines = {};
+		myPushConstantGraphicsPipelines = {};
+		myBindlessGraphicsPipelines = {};
 		
 		myDeviceTable.vkDestroyPipelineLayout(myDevice, myPipelineLayout, nullptr);
+		myDeviceTable.vkDestroyPipelineLayout(myDevice, myPushConstantPipelineLayout, nullptr);
 		myDeviceTable.vkDestroyRenderPass(myDevice, myRenderPass, nullptr);
 	}
 
 	void cleanup()
 	{
+		for (uint32_t frameIt = 0; frameIt < myFrameCount; frameIt++)
+			runDeferredDestroys(frameIt);
+
+		cleanupUploadResources();
+
 		cleanupFrameResources();
 
-		ImGui_ImplVulkan_Shutdown();
+		if (!myHeadlessFlag)
+		{
+			ImGui_ImplVulkan_Shutdown();
 
-		ImGui::DestroyContext();
+			ImGui::DestroyContext();
+		}
 
 		vmaDestroyBuffer(myAllocator, myUniformBuffer, myUniformBufferMemory);
+		vmaDestroyBuffer(myAllocator, myInstanceBuffer, myInstanceBufferMemory);
+		vmaDestroyBuffer(myAllocator, myCullInputBuffer, myCullInputBufferMemory);
+		vmaDestroyBuffer(myAllocator, myDrawCommandBuffer, myDrawCommandBufferMemory);
+		vmaDestroyBuffer(myAllocator, myStagingBuffer, myStagingBufferMemory);
 		
 		{
 			// vmaDestroyBuffer(myAllocator, myQuadModel.myVertexBuffer, myQuadModel.myVertexBufferMemory);
@@ -2037,16 +4255,23 @@ private:
 			myDeviceTable.vkDestroyImageView(myDevice, myHouseImage.myImageView, nullptr);
 		}
 
+		myDeviceTable.vkDestroyPipeline(myDevice, myCullPipeline, nullptr);
+		myDeviceTable.vkDestroyPipelineLayout(myDevice, myCullPipelineLayout, nullptr);
+		myDeviceTable.vkDestroyDescriptorSetLayout(myDevice, myCullDescriptorSetLayout, nullptr);
+
 		myDeviceTable.vkDestroySampler(myDevice, mySampler, nullptr);
 
 		myDeviceTable.vkDestroyDescriptorSetLayout(myDevice, myDescriptorSetLayout, nullptr);
 		myDeviceTable.vkDestroyDescriptorPool(myDevice, myDescriptorPool, nullptr);
+		myDeviceTable.vkDestroyDescriptorSetLayout(myDevice, myTextureTableSetLayout, nullptr);
+		myDeviceTable.vkDestroyDescriptorPool(myDevice, myTextureTablePool, nullptr);
 
 		vmaDestroyAllocator(myAllocator);
 
 		myDeviceTable.vkDestroyDevice(myDevice, nullptr);
 		
-		vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
+		if (!myHeadlessFlag)
+			vkDestroySurfaceKHR(myInstance, mySurface, nullptr);
 
 		vkDestroyDebugReportCallbackEXT(myInstance, myDebugCallback, nullptr);
 
@@ -2061,17 +4286,143 @@ private:
 		glm::mat4 pad;
 	};
 
+	// cpu side copy of the per draw transforms, relative to the unquantized mesh, used for culling
+	struct DrawTransform
+	{
+		glm::mat4 modelViewProj;
+		glm::vec3 cameraPosition; // in object space
+		float projectionScale; // proj[1][1], cot(fov / 2)
+	};
+
+	// per draw data of the push constant pipelines, within the 128 bytes every device has
+	struct DrawPushConstants
+	{
+		glm::mat4 modelViewProj; // proj * view * model, including any dequantization
+		uint32_t textureIndex; // slot in the texture table, only read by the bindless pipelines
+	};
+
+	// Secondaries of a frame recorded on one thread of myJobSystem. The pool is reset as a whole once
+	// the frame's fence has signaled, and the buffers are handed out again in the same order.
+	struct ThreadCommandPool
+	{
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> commandBuffers; // allocated on demand
+		uint32_t usedCount = 0; // since the last reset
+	};
+
+	// consecutive indices drawn with one call
+	struct IndexRange
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// one tile of a segment's draw list
+	struct TileDraw
+	{
+		VkRect2D rect; // viewport and scissor
+		DrawPushConstants pushConstants; // push constant pipelines only
+		uint32_t uniformBufferOffset; // the other pipelines
+		uint32_t firstRange; // in SegmentDrawList::ranges
+		uint32_t rangeCount;
+	};
+
+	// What a secondary command buffer draws, gathered before it is recorded. Instanced draws only
+	// have ranges, one per multi viewport draw.
+	struct SegmentDrawList
+	{
+		std::vector<TileDraw> draws;
+		std::vector<IndexRange> ranges;
+		uint64_t key = 0; // hash of the draws and the state they are recorded with
+	};
+
+	// std430 head of a frame's cull input partition, followed by the NX * NY draw transforms. see Cull.comp.
+	struct CullInput
+	{
+		glm::vec4 boundingSphere;
+		uint32_t instanceCount;
+		uint32_t viewportCount; // instances per multi viewport draw
+		uint32_t lodCount;
+		float maxPixelError;
+		float tileHalfHeight; // in pixels
+		struct
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		} lods[MeshLod::MaxCount];
+		uint32_t pad[3];
+	};
+	static_assert(sizeof(CullInput) == 144);
+
+	// the ui edits them while a frame is recorded, so every frame takes a copy when it starts
+	struct RenderOptions
+	{
+		bool meshletCulling = true;
+		bool instancedDraw = false; // one multi viewport draw per myInstancedViewportCount tiles
+		bool gpuCulling = false; // instanced draws are culled, lod selected and drawn indirectly on the gpu
+		bool pushConstants = false; // per draw transforms are pushed, descriptor sets bound once per command buffer
+		bool bindlessTextures = false; // push constant draws index the texture table instead
+		float lodPixelError = 1.0f; // largest screen space error of a selected lod, 0 always draws full detail
+		bool pipelinedUpdate = false; // transforms are simulated one frame ahead on mySimulationThread
+		bool commandBufferCaching = false; // secondaries are only recorded when what they draw changes
+	};
+
+	// the transforms of every instance of a frame, simulated ahead of the frame that renders them and
+	// not changed after it was published
+	struct FramePacket
+	{
+		InstanceAnimation animation;
+		std::vector<InstanceUniforms> uniforms = std::vector<InstanceUniforms>(NX * NY);
+		std::vector<InstanceDrawTransform> drawTransforms = std::vector<InstanceDrawTransform>(NX * NY);
+		std::vector<InstanceVertex> instances = std::vector<InstanceVertex>(NX * NY);
+	};
+
+	// what the simulation needs to know about the renderer, as of the last recorded frame
+	struct SimulationInput
+	{
+		float aspect = 1.0f;
+		glm::mat4 dequantize = glm::mat4(1);
+	};
+
+	// what the ui shows of the last frame, taken before the frame being recorded starts changing it
+	struct FrameStats
+	{
+		uint32_t visibleMeshletCount = 0;
+		uint32_t drawnTriangleCount = 0;
+		uint64_t stagingUsedSize = 0;
+		uint64_t stagingHighWaterMark = 0;
+	};
+
+	// finished by the load job system, waiting for the frame loop to upload them over target
+	struct LoadedModel
+	{
+		Model* target;
+		std::unique_ptr<ModelData> data;
+		std::string name;
+	};
+
+	struct LoadedTexture
+	{
+		Texture* target;
+		std::unique_ptr<ImageData> data;
+		std::string name;
+	};
+
 	VkInstance myInstance = VK_NULL_HANDLE;
 	VkDebugReportCallbackEXT myDebugCallback = VK_NULL_HANDLE;
 	VkSurfaceKHR mySurface = VK_NULL_HANDLE; // todo: take ownership of this object from IMGUI
 	VkSurfaceFormatKHR mySurfaceFormat = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
 	VkPresentModeKHR myPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
 	VkPhysicalDevice myPhysicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceFeatures myPhysicalDeviceFeatures = {};
 	VkDevice myDevice = VK_NULL_HANDLE;
 	VolkDeviceTable myDeviceTable = {};
 	VmaAllocator myAllocator = VK_NULL_HANDLE;
 	int myQueueFamilyIndex = -1;
 	VkQueue myQueue = VK_NULL_HANDLE;
+	int myTransferQueueFamilyIndex = -1; // == myQueueFamilyIndex if the device has no other queue family
+	VkQueue myTransferQueue = VK_NULL_HANDLE; // == myQueue if the device only has one queue
 	VkDescriptorPool myDescriptorPool = VK_NULL_HANDLE;
 	VkDescriptorSetLayout myDescriptorSetLayout = VK_NULL_HANDLE;
 	VkDescriptorSet myDescriptorSet = VK_NULL_HANDLE;
@@ -2088,20 +4439,98 @@ private:
 		};
 
 		VkPipeline data[Count] = { VK_NULL_HANDLE };
+
+		inline bool isValid() const { return data[NoAlphaTest] != VK_NULL_HANDLE; }
 	} myGraphicsPipelines;
+	GraphicsPipelines myInstancedGraphicsPipelines; // only created if myInstancedViewportCount > 0 and the shaders were built
+	VkPipelineLayout myPushConstantPipelineLayout = VK_NULL_HANDLE; // myPipelineLayout plus DrawPushConstants
+	GraphicsPipelines myPushConstantGraphicsPipelines; // only created if the shaders were built
+	GraphicsPipelines myBindlessGraphicsPipelines; // push constant pipelines sampling the texture table, if there is one and the shaders were built
+	VkDescriptorPool myTextureTablePool = VK_NULL_HANDLE; // update after bind
+	VkDescriptorSetLayout myTextureTableSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSet myTextureTableSet = VK_NULL_HANDLE;
+	std::vector<uint32_t> myFreeTextureTableSlots;
 	VkSampler mySampler = VK_NULL_HANDLE;
 	VkBuffer myUniformBuffer = VK_NULL_HANDLE;
 	VmaAllocation myUniformBufferMemory = VK_NULL_HANDLE;
+	char* myUniformBufferData = nullptr; // persistently mapped
+	VkDeviceSize myUniformBufferStride = 0; // sizeof(UniformBufferObject), aligned for dynamic offsets
+	VkDeviceSize myUniformBufferFrameSize = 0; // NX * NY slots
+	VkBuffer myInstanceBuffer = VK_NULL_HANDLE; // only created if myInstancedViewportCount > 0
+	VmaAllocation myInstanceBufferMemory = VK_NULL_HANDLE;
+	InstanceVertex* myInstanceBufferData = nullptr; // persistently mapped, count = [frameCount * NX * NY]
+	VkDescriptorSetLayout myCullDescriptorSetLayout = VK_NULL_HANDLE; // cull resources are only created if myGpuCullingSupported
+	VkDescriptorSet myCullDescriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout myCullPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline myCullPipeline = VK_NULL_HANDLE;
+	VkBuffer myCullInputBuffer = VK_NULL_HANDLE;
+	VmaAllocation myCullInputBufferMemory = VK_NULL_HANDLE;
+	char* myCullInputBufferData = nullptr; // persistently mapped
+	VkDeviceSize myCullInputFrameSize = 0; // CullInput and NX * NY draw transforms, aligned for dynamic offsets
+	VkBuffer myDrawCommandBuffer = VK_NULL_HANDLE; // NX * NY VkDrawIndexedIndirectCommand, then the draw counts
+	VmaAllocation myDrawCommandBufferMemory = VK_NULL_HANDLE;
+	VkDeviceSize myDrawCountOffset = 0;
+	VkBuffer myStagingBuffer = VK_NULL_HANDLE; // persistently mapped, sub-allocated by myStagingRing
+	VmaAllocation myStagingBufferMemory = VK_NULL_HANDLE;
+	char* myStagingBufferData = nullptr;
+	VkDeviceSize myStagingAlignment = 0;
+	std::unique_ptr<RingAllocator> myStagingRing;
+	VkCommandPool myUploadCommandPools[UploadQueue::Count] = {};
+	std::vector<UploadBatch> mySubmittedUploadBatches; // in submission order
+	std::vector<UploadBatch> myFreeUploadBatches[UploadQueue::Count];
+	std::vector<VkSemaphore> myUploadCompleteSemaphores; // count = [frameCount], signaled by the frame's transfer queue batch
+	VkSemaphore myFrameUploadSemaphore = VK_NULL_HANDLE; // waited by the frame being recorded, if it submitted a transfer queue batch
+	std::vector<VkBufferMemoryBarrier> myAcquireBufferBarriers; // ownership acquires for the frame being recorded
+	std::vector<VkImageMemoryBarrier> myAcquireImageBarriers;
 	VkFormat myDepthFormat = VK_FORMAT_UNDEFINED;
 	VkImage myDepthImage = VK_NULL_HANDLE;
 	VmaAllocation myDepthImageMemory = VK_NULL_HANDLE;
 	VkImageView myDepthImageView = VK_NULL_HANDLE;
 
-	std::vector<VkCommandPool> myCommandPools; // count = [threadCount]
-	std::vector<VkCommandBuffer> myCommandBuffers; // count = [frameCount*threadCount] [f0cb0 f0cb1 f1cb0 f1cb1 f2cb0 f2cb1 ...]
+	std::vector<VkCommandPool> myPrimaryCommandPools; // count = [frameCount]
+	std::vector<ThreadCommandPool> myThreadCommandPools; // count = [frameCount*threadCount] [f0t0 f0t1 f1t0 f1t1 f2t0 f2t1 ...]
+	std::vector<VkCommandPool> mySegmentCommandPools; // count = [frameCount*segmentCount], of the cached secondaries
+	std::vector<VkCommandBuffer> myCachedCommandBuffers; // count = [frameCount*segmentCount], allocated when first recorded
+	std::vector<VkCommandBuffer> mySegmentCommandBuffers; // count = [frameCount*segmentCount], what the primary executes
+	std::vector<uint64_t> mySegmentKeys; // count = [frameCount*segmentCount], key of what a cached secondary was recorded from, 0 if none
+	uint64_t myResourceGeneration = 0; // bumped whenever models, textures or their descriptor sets are replaced
+	std::vector<SegmentDrawList> mySegmentDrawLists; // count = [threadCount - 1]
 	std::vector<VkFence> myFrameFences; // count = [frameCount]
 	std::vector<VkSemaphore> myImageAcquiredSemaphores; // count = [frameCount]
 	std::vector<VkSemaphore> myRenderCompleteSemaphores; // count = [frameCount]
+	VkSemaphore myCurrentImageAcquiredSemaphore = VK_NULL_HANDLE; // signaled by the acquire in beginFrame()
+	std::vector<std::vector<std::function<void()>>> myFrameDeletionQueues; // count = [frameCount]
+
+	// headless mode only
+	std::vector<VkImage> myOffscreenImages; // count = [frameCount]
+	std::vector<VmaAllocation> myOffscreenImageMemory; // count = [frameCount]
+	std::vector<VkImageView> myOffscreenImageViews; // count = [frameCount]
+	std::vector<VkFramebuffer> myOffscreenFramebuffers; // count = [frameCount]
+	std::vector<double> myFrameTimings; // cpu time in ms of each draw() call
+
+	std::vector<DrawTransform> myDrawTransforms = std::vector<DrawTransform>(NX * NY);
+	std::atomic<uint32_t> myVisibleMeshletCount = 0; // of the frame being recorded
+	std::atomic<uint32_t> myDrawnTriangleCount = 0; // of the frame being recorded
+	FrameStats myLastFrameStats; // shown by the ui
+
+	TaskGraph myFrameGraph; // rebuilt by buildFrameGraph() every frame
+	InstanceAnimation myFrameAnimation; // set up by beginUniformUpdate()
+
+	// pipelined update only
+	std::unique_ptr<TripleBuffer<FramePacket>> myFramePackets;
+	std::thread mySimulationThread;
+	std::mutex mySimulationInputMutex;
+	SimulationInput mySimulationInput; // guarded by mySimulationInputMutex
+	const FramePacket* myFramePacket = nullptr; // of the frame being recorded
+	bool myFramePacketValidFlag = false; // myFramePacket was simulated with myFrameAnimation
+
+	std::unique_ptr<JobSystem> myJobSystem;
+	std::unique_ptr<JobSystem> myLoadJobSystem; // separate from myJobSystem, which is recreated with the frame resources
+
+	std::mutex myLoadedAssetsMutex;
+	std::vector<LoadedModel> myLoadedModels;
+	std::vector<LoadedTexture> myLoadedTextures;
+	std::atomic<uint32_t> myPendingLoadCount = 0;
 
 	std::unique_ptr<ImGui_ImplVulkanH_WindowData> myWindowData;
 	std::vector<ImFont*> myFonts;
@@ -2117,20 +4546,32 @@ private:
 	uint32_t myCommandBufferThreadCount = 0;
 	int myRequestedCommandBufferThreadCount = 0;
 
+	uint64_t myFrameNumber = 0;
+	std::chrono::high_resolution_clock::time_point myStartTime = std::chrono::high_resolution_clock::now();
+
 	bool myUIEnableFlag = false;
 	bool myCreateFrameResourcesFlag = false;
+	bool myHeadlessFlag = false;
+	bool myVerboseFlag = false;
+	bool myOptimizeModelsFlag = true;
+	uint32_t myVertexFormat = VertexFormat::Float;
+	RenderOptions myRenderOptions; // of the frame being recorded
+	RenderOptions myRequestedRenderOptions; // edited by the ui, picked up by the next frame
+	bool myTextureTableSupported = false; // VK_EXT_descriptor_indexing, dynamic indexing, partially bound, update after bind and while pending
+	uint32_t myInstancedViewportCount = 0; // 0 if the device can't select viewports in the vertex shader
+	bool myGpuCullingSupported = false;
+	bool myDrawIndirectCountSupported = false; // VK_KHR_draw_indirect_count
 
 	static constexpr uint32_t NX = 8;
 	static constexpr uint32_t NY = 4;
+	static constexpr VkDeviceSize StagingRingSize = 64 * 1024 * 1024;
+	static constexpr uint32_t TextureTableSize = 64; // textureTable in Shader.frag
 };
 
 static VulkanApplication* theApp = nullptr;
 
-int vkapp_create(void* view, int windowWidth, int windowHeight, int framebufferWidth, int framebufferHeight, const char* resourcePath, bool verbose)
+static void vkapp_init_environment(bool verbose)
 {
-	assert(view != nullptr);
-	assert(theApp == nullptr);
-
 	static const char* DISABLE_VK_LAYER_VALVE_steam_overlay_1 = "DISABLE_VK_LAYER_VALVE_steam_overlay_1=1";
 #if defined(__WINDOWS__)
 	_putenv((char*)DISABLE_VK_LAYER_VALVE_steam_overlay_1);
@@ -2152,12 +4593,81 @@ int vkapp_create(void* view, int windowWidth, int windowHeight, int framebufferW
 		if (char* vkIcdFilenames = getenv(VK_ICD_FILENAMES_STR))
 			std::cout << VK_ICD_FILENAMES_STR << "=" << vkIcdFilenames << std::endl;
 	}
+}
+
+int vkapp_create(void* view, int windowWidth, int windowHeight, int framebufferWidth, int framebufferHeight, const char* resourcePath, bool verbose)
+{
+	assert(view != nullptr);
+	assert(theApp == nullptr);
+
+	vkapp_init_environment(verbose);
 
 	theApp = new VulkanApplication(view, windowWidth, windowHeight, framebufferWidth, framebufferHeight, resourcePath ? resourcePath : "./", verbose);
 
 	return EXIT_SUCCESS;
 }
 
+int vkapp_create_headless(int framebufferWidth, int framebufferHeight, const char* resourcePath, bool verbose)
+{
+	assert(theApp == nullptr);
+
+	vkapp_init_environment(verbose);
+
+	theApp = new VulkanApplication(nullptr, framebufferWidth, framebufferHeight, framebufferWidth, framebufferHeight, resourcePath ? resourcePath : "./", verbose);
+
+	return EXIT_SUCCESS;
+}
+
+void vkapp_run_headless(int frameCount)
+{
+	assert(theApp != nullptr);
+	assert(frameCount >= 0);
+
+	theApp->runHeadless(static_cast<uint32_t>(frameCount));
+}
+
+void vkapp_set_gpu_culling(bool enabled)
+{
+	assert(theApp != nullptr);
+
+	theApp->setGpuCulling(enabled);
+}
+
+void vkapp_set_push_constants(bool enabled)
+{
+	assert(theApp != nullptr);
+
+	theApp->setPushConstants(enabled);
+}
+
+void vkapp_set_pipelined_update(bool enabled)
+{
+	assert(theApp != nullptr);
+
+	theApp->setPipelinedUpdate(enabled);
+}
+
+void vkapp_set_command_buffer_caching(bool enabled)
+{
+	assert(theApp != nullptr);
+
+	theApp->setCommandBufferCaching(enabled);
+}
+
+void vkapp_set_optimize_models(bool enabled)
+{
+	assert(theApp != nullptr);
+
+	theApp->setOptimizeModels(enabled);
+}
+
+void vkapp_set_packed_vertices(bool enabled)
+{
+	assert(theApp != nullptr);
+
+	theApp->setVertexFormat(enabled ? VertexFormat::Packed : VertexFormat::Float);
+}
+
 void vkapp_draw()
 {
 	assert(theApp != nullptr);
@@ -6,6 +6,14 @@ extern "C"
 #endif
 
 int vkapp_create(void* view, int windowWidth, int windowHeight, int framebufferWidth, int framebufferHeight, const char* resourcePath, bool verbose);
+int vkapp_create_headless(int framebufferWidth, int framebufferHeight, const char* resourcePath, bool verbose);
+void vkapp_run_headless(int frameCount);
+void vkapp_set_gpu_culling(bool enabled);
+void vkapp_set_push_constants(bool enabled);
+void vkapp_set_pipelined_update(bool enabled);
+void vkapp_set_command_buffer_caching(bool enabled);
+void vkapp_set_optimize_models(bool enabled);
+void vkapp_set_packed_vertices(bool enabled);
 void vkapp_draw();
 void vkapp_resize(int framebufferWidth, int framebufferHeight);
 void vkapp_destroy(void);
@@ -0,0 +1,107 @@
+#include "../JobSystem.h"
+#include "../ObjParser.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compares the tinyobj based import path that loadModel used to take against the parallel
+// chunked parser on the same file.
+//
+// usage: objparserbenchmark [-f <file.obj>] [-i <iterations>] [-t <threads>]
+
+static char* getCmdOption(char** begin, char** end, const std::string& option)
+{
+	char** it = std::find(begin, end, option);
+	if (it != end && ++it != end)
+		return *it;
+
+	return nullptr;
+}
+
+template <typename Function>
+static double measureBestOf(uint32_t iterationCount, Function&& function)
+{
+	double best = std::numeric_limits<double>::max();
+	for (uint32_t iterationIt = 0; iterationIt < iterationCount; iterationIt++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		function();
+		best = std::min(best, std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	char* fileStr = getCmdOption(argv, argv + argc, "-f");
+	char* iterationsStr = getCmdOption(argv, argv + argc, "-i");
+	char* threadsStr = getCmdOption(argv, argv + argc, "-t");
+
+	const char* file = fileStr ? fileStr : "./resources/models/chalet.obj";
+	uint32_t iterationCount = std::max(iterationsStr ? atoi(iterationsStr) : 3, 1);
+	uint32_t threadCount = std::max(threadsStr ? atoi(threadsStr) : static_cast<int>(std::thread::hardware_concurrency()), 2);
+
+	try
+	{
+		size_t tinyobjIndexCount = 0;
+		double tinyobjTime = measureBestOf(iterationCount, [&file, &tinyobjIndexCount]
+		{
+			tinyobj::attrib_t attrib;
+			std::vector<tinyobj::shape_t> shapes;
+			std::vector<tinyobj::material_t> materials;
+			std::string warn, err;
+
+			std::ifstream stream(file, std::ios::in | std::ios::binary);
+			if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream))
+				throw std::runtime_error(err);
+
+			tinyobjIndexCount = 0;
+			for (const auto& shape : shapes)
+				tinyobjIndexCount += shape.mesh.indices.size();
+		});
+
+		// the calling thread takes part as well
+		JobSystem jobSystem(threadCount - 1);
+
+		size_t objParserIndexCount = 0;
+		double objParserTime = measureBestOf(iterationCount, [&file, &jobSystem, &objParserIndexCount]
+		{
+			ObjMesh mesh;
+			loadObj(file, jobSystem, mesh);
+
+			objParserIndexCount = mesh.indices.size();
+		});
+
+		std::cout << file << " (best of " << iterationCount << ")\n";
+		std::cout << "tinyobj::LoadObj: " << tinyobjTime << " ms, " << tinyobjIndexCount << " indices\n";
+		std::cout << "loadObj (" << threadCount << " threads): " << objParserTime << " ms, "
+			<< objParserIndexCount << " indices\n";
+		std::cout << "speedup: " << tinyobjTime / objParserTime << "x" << std::endl;
+
+		if (tinyobjIndexCount != objParserIndexCount)
+		{
+			std::cout << "index count mismatch!" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cout << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
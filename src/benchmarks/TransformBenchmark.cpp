@@ -0,0 +1,177 @@
+#include "../InstanceTransforms.h"
+#include "../JobSystem.h"
+#include "../Math.h"
+
+#define GLM_LANG_STL11_FORCED
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compares the per instance glm loop that updateUniformBuffers used to run against the batched
+// instance transform kernel, on one thread and spread over the job system.
+//
+// usage: transformbenchmark [-n <instances>] [-i <iterations>] [-t <threads>]
+
+static char* getCmdOption(char** begin, char** end, const std::string& option)
+{
+	char** it = std::find(begin, end, option);
+	if (it != end && ++it != end)
+		return *it;
+
+	return nullptr;
+}
+
+template <typename Function>
+static double measureBestOf(uint32_t iterationCount, Function&& function)
+{
+	double best = std::numeric_limits<double>::max();
+	for (uint32_t iterationIt = 0; iterationIt < iterationCount; iterationIt++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		function();
+		best = std::min(best, std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+// same as the uniform buffer slots of the renderer
+struct UniformBufferObject
+{
+	glm::mat4 model;
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::mat4 pad;
+};
+
+int main(int argc, char** argv)
+{
+	char* instancesStr = getCmdOption(argv, argv + argc, "-n");
+	char* iterationsStr = getCmdOption(argv, argv + argc, "-i");
+	char* threadsStr = getCmdOption(argv, argv + argc, "-t");
+
+	uint32_t instanceCount = std::max(instancesStr ? atoi(instancesStr) : 100000, 1);
+	uint32_t iterationCount = std::max(iterationsStr ? atoi(iterationsStr) : 20, 1);
+	uint32_t threadCount = std::max(threadsStr ? atoi(threadsStr) : static_cast<int>(std::thread::hardware_concurrency()), 2);
+
+	InstanceAnimation animation;
+	animation.time = 3.7f;
+	animation.depth = -0.01f - std::numeric_limits<float>::epsilon();
+
+	const float aspect = 16.0f / 9.0f;
+	const glm::mat4 dequantize = glm::translate(glm::scale(glm::mat4(1), glm::vec3(2.0f)), glm::vec3(-0.5f));
+
+	std::copy_n(glm::value_ptr(glm::mat4(1)), 16, animation.view0);
+	std::copy_n(glm::value_ptr(glm::lookAt(glm::vec3(1.5f, 1.5f, 1.0f), glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(0.0f, 0.0f, -1.0f))), 16, animation.view1);
+	std::copy_n(glm::value_ptr(glm::mat4(glm::frustum(-1.0, 1.0, -1.0, 1.0, 0.01, 10.0))), 16, animation.proj0);
+	std::copy_n(glm::value_ptr(glm::perspective(glm::radians(75.0f), aspect, 0.01f, 10.0f)), 16, animation.proj1);
+	std::copy_n(glm::value_ptr(dequantize), 16, animation.dequantize);
+
+	std::vector<UniformBufferObject> referenceUniforms(instanceCount);
+	std::vector<InstanceDrawTransform> referenceDrawTransforms(instanceCount);
+	double referenceTime = measureBestOf(iterationCount, [&]
+	{
+		const float period = animation.period;
+
+		for (uint32_t n = 0; n < instanceCount; n++)
+		{
+			UniformBufferObject& ubo = referenceUniforms[n];
+
+			float tp = fmod((animation.phaseStep * n) + animation.time, period);
+			float s = smootherstep(
+				smoothstep(clamp(ramp(tp < (0.5f * period) ? tp : period - tp, 0, 0.5f * period), 0, 1)));
+
+			glm::mat4 model = glm::rotate(
+				glm::translate(glm::mat4(1), glm::vec3(0, 0, animation.depth)),
+				s * glm::radians(360.0f),
+				glm::vec3(0.0, 0.0, 1.0));
+
+			glm::mat4 view0 = glm::mat4(1);
+			glm::mat4 proj0 = glm::frustum(-1.0, 1.0, -1.0, 1.0, 0.01, 10.0);
+			glm::mat4 view1 = glm::lookAt(glm::vec3(1.5f, 1.5f, 1.0f), glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(0.0f, 0.0f, -1.0f));
+			glm::mat4 proj1 = glm::perspective(glm::radians(75.0f), aspect, 0.01f, 10.0f);
+
+			ubo.model = model * dequantize;
+			ubo.view = glm::mat4(
+				lerp(view0[0], view1[0], s),
+				lerp(view0[1], view1[1], s),
+				lerp(view0[2], view1[2], s),
+				lerp(view0[3], view1[3], s));
+			ubo.proj = glm::mat4(
+				lerp(proj0[0], proj1[0], s),
+				lerp(proj0[1], proj1[1], s),
+				lerp(proj0[2], proj1[2], s),
+				lerp(proj0[3], proj1[3], s));
+
+			InstanceDrawTransform& drawTransform = referenceDrawTransforms[n];
+			std::copy_n(glm::value_ptr(ubo.proj * ubo.view * model), 16, drawTransform.modelViewProj);
+			std::copy_n(glm::value_ptr(glm::inverse(ubo.view * model)[3]), 3, drawTransform.cameraPosition);
+			drawTransform.projectionScale = std::abs(ubo.proj[1][1]);
+		}
+	});
+
+	std::vector<UniformBufferObject> uniforms(instanceCount);
+	std::vector<InstanceDrawTransform> drawTransforms(instanceCount);
+	double kernelTime = measureBestOf(iterationCount, [&]
+	{
+		updateInstanceTransforms(animation, 0, instanceCount, uniforms.data(), sizeof(UniformBufferObject), drawTransforms.data());
+	});
+
+	// the calling thread takes part as well
+	JobSystem jobSystem(threadCount - 1);
+
+	constexpr uint32_t instancesPerJob = 4096;
+	uint32_t jobCount = (instanceCount + instancesPerJob - 1) / instancesPerJob;
+	double jobsTime = measureBestOf(iterationCount, [&]
+	{
+		jobSystem.parallelFor(jobCount, [&](uint32_t jobIt)
+		{
+			uint32_t begin = jobIt * instancesPerJob;
+			uint32_t end = std::min(begin + instancesPerJob, instanceCount);
+
+			updateInstanceTransforms(animation, begin, end, uniforms.data(), sizeof(UniformBufferObject), drawTransforms.data());
+		});
+	});
+
+	float maxError = 0.0f;
+	for (uint32_t n = 0; n < instanceCount; n++)
+	{
+		const float* reference = glm::value_ptr(referenceUniforms[n].model);
+		const float* result = glm::value_ptr(uniforms[n].model);
+		for (uint32_t i = 0; i < 48; i++)
+			maxError = std::max(maxError, std::abs(reference[i] - result[i]));
+
+		reference = referenceDrawTransforms[n].modelViewProj;
+		result = drawTransforms[n].modelViewProj;
+		for (uint32_t i = 0; i < 20; i++)
+			maxError = std::max(maxError, std::abs(reference[i] - result[i]));
+	}
+
+	std::cout << instanceCount << " instances (best of " << iterationCount << ")\n";
+	std::cout << "per instance glm: " << referenceTime << " ms\n";
+	std::cout << "updateInstanceTransforms: " << kernelTime << " ms\n";
+	std::cout << "updateInstanceTransforms (" << threadCount << " threads): " << jobsTime << " ms\n";
+	std::cout << "speedup: " << referenceTime / jobsTime << "x, max error: " << maxError << std::endl;
+
+	if (maxError > 1e-3f)
+	{
+		std::cout << "transform mismatch!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
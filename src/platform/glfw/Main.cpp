@@ -7,23 +7,74 @@
 #include <imgui.h>
 #include <examples/imgui_impl_glfw.h>
 
+#include "../../ConcurrentFunctionQueue.h"
 #include "../../Volcano.h"
 
+#include <algorithm>
+#include <string>
+#include <thread>
+
+using RenderQueue = ConcurrentFunctionQueue<>;
+
 static void glfw_error_callback(int error, const char* description)
 {
 	fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
-static void glfw_resize_callback(GLFWwindow*, int w, int h)
+static void glfw_resize_callback(GLFWwindow* window, int w, int h)
 {
-	vkapp_resize(w, h);
+	// all vkapp calls after creation are made on the render thread
+	auto renderQueue = static_cast<RenderQueue*>(glfwGetWindowUserPointer(window));
+	renderQueue->Queue(vkapp_resize, w, h);
 }
 
-int main(int, char**)
+static char* getCmdOption(char** begin, char** end, const std::string& option)
 {
-	// todo: parse commandline
-	static constexpr uint32_t windowWidth = 1280;
-	static constexpr uint32_t windowHeight = 720;
+	char** it = std::find(begin, end, option);
+	if (it != end && ++it != end)
+		return *it;
+
+	return nullptr;
+}
+
+static bool cmdOptionExists(char** begin, char** end, const std::string& option)
+{
+	return std::find(begin, end, option) != end;
+}
+
+int main(int argc, char** argv)
+{
+	char* widthStr = getCmdOption(argv, argv + argc, "-w");
+	char* heightStr = getCmdOption(argv, argv + argc, "-h");
+	char* resourcePathStr = getCmdOption(argv, argv + argc, "-r");
+	char* headlessFrameCountStr = getCmdOption(argv, argv + argc, "-headless");
+	bool verbose = !cmdOptionExists(argv, argv + argc, "-quiet");
+	bool gpuCulling = cmdOptionExists(argv, argv + argc, "-gpuculling");
+	bool pushConstants = cmdOptionExists(argv, argv + argc, "-pushconstants");
+	bool pipelinedUpdate = cmdOptionExists(argv, argv + argc, "-pipelined");
+	bool commandBufferCaching = cmdOptionExists(argv, argv + argc, "-cachecommandbuffers");
+	bool optimizeModels = !cmdOptionExists(argv, argv + argc, "-nooptimizemodels");
+	bool packedVertices = cmdOptionExists(argv, argv + argc, "-packedvertices");
+
+	int windowWidth = widthStr ? atoi(widthStr) : 1280;
+	int windowHeight = heightStr ? atoi(heightStr) : 720;
+	const char* resourcePath = resourcePathStr ? resourcePathStr : "./resources/";
+
+	// Render a fixed number of frames offscreen and print the frame timings, no window needed
+	if (headlessFrameCountStr)
+	{
+		vkapp_create_headless(windowWidth, windowHeight, resourcePath, verbose);
+		vkapp_set_gpu_culling(gpuCulling);
+		vkapp_set_push_constants(pushConstants);
+		vkapp_set_pipelined_update(pipelinedUpdate);
+		vkapp_set_command_buffer_caching(commandBufferCaching);
+		vkapp_set_optimize_models(optimizeModels);
+		vkapp_set_packed_vertices(packedVertices);
+		vkapp_run_headless(atoi(headlessFrameCountStr));
+		vkapp_destroy();
+
+		return 0;
+	}
 
 	// Setup window
 	glfwSetErrorCallback(glfw_error_callback);
@@ -43,7 +94,16 @@ int main(int, char**)
 	int framebufferWidth, framebufferHeight;
 	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
-	vkapp_create(window, windowWidth, windowHeight, framebufferWidth, framebufferHeight, "./resources/", true);
+	vkapp_create(window, windowWidth, windowHeight, framebufferWidth, framebufferHeight, resourcePath, verbose);
+	vkapp_set_gpu_culling(gpuCulling);
+	vkapp_set_push_constants(pushConstants);
+	vkapp_set_pipelined_update(pipelinedUpdate);
+	vkapp_set_command_buffer_caching(commandBufferCaching);
+	vkapp_set_optimize_models(optimizeModels);
+	vkapp_set_packed_vertices(packedVertices);
+
+	RenderQueue renderQueue;
+	glfwSetWindowUserPointer(window, &renderQueue);
 
 	// Create Framebuffer resize callback
 	glfwSetFramebufferSizeCallback(window, glfw_resize_callback);
@@ -51,6 +111,18 @@ int main(int, char**)
 	// Setup GLFW binding
 	ImGui_ImplGlfw_InitForVulkan(window, true);
 
+	// only read and written on the render thread
+	bool renderThreadExitFlag = false;
+
+	std::thread renderThread([&renderQueue, &renderThreadExitFlag]
+	{
+		while (!renderThreadExitFlag)
+		{
+			renderQueue.Wait();
+			renderQueue.RunAll();
+		}
+	});
+
 	while (!glfwWindowShouldClose(window))
 	{
 		// Poll and handle events (inputs, window resize, etc.)
@@ -65,9 +137,15 @@ int main(int, char**)
 
 		ImGui_ImplGlfw_NewFrame();
 
-		vkapp_draw();
+		renderQueue.Queue(vkapp_draw);
+
+		// the render thread reads the imgui input state that the next poll writes to
+		renderQueue.WaitIdle();
 	}
 
+	renderQueue.Queue([&renderThreadExitFlag] { renderThreadExitFlag = true; });
+	renderThread.join();
+
 	ImGui_ImplGlfw_Shutdown();
 
 	vkapp_destroy();